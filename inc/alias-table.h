@@ -0,0 +1,25 @@
+/*
+ * alias-table.h
+ *
+ * Walker alias tables for drawing from a discrete distribution in O(1).
+ */
+
+#if !defined(_ALIAS_TABLE_H)
+#define _ALIAS_TABLE_H
+
+#define ALIAS_TABLE_MAX 32
+
+/*
+ * Outcome i is drawn with a probability proportional to its weight.
+ * A column is picked uniformly, then it is kept with probability prob, or replaced by its alias.
+ */
+struct alias_table {
+	int num;
+	double prob[ALIAS_TABLE_MAX];
+	int alias[ALIAS_TABLE_MAX];
+};
+
+int alias_table_build(struct alias_table *table, const double *weights, int num);
+int alias_table_draw(const struct alias_table *table);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * alloc-debug.h
+ *
+ * Counter of the heap allocations of the application code.
+ */
+
+#if !defined(_ALLOC_DEBUG_H)
+#define _ALLOC_DEBUG_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ALLOC_DEBUG)
+
+/*
+ * With ALLOC_DEBUG defined, the allocations of the files that include this header last are counted.
+ * Allocations inside the platform libraries are not counted.
+ */
+extern unsigned int alloc_debug_count;
+
+void *alloc_debug_malloc(size_t size, const char *file, int line);
+void *alloc_debug_calloc(size_t count, size_t size, const char *file, int line);
+void *alloc_debug_realloc(void *ptr, size_t size, const char *file, int line);
+char *alloc_debug_strdup(const char *str, const char *file, int line);
+void alloc_debug_assert_none_since(unsigned int mark, const char *what);
+
+#define malloc(size) alloc_debug_malloc((size), __FILE__, __LINE__)
+#define calloc(count, size) alloc_debug_calloc((count), (size), __FILE__, __LINE__)
+#define realloc(ptr, size) alloc_debug_realloc((ptr), (size), __FILE__, __LINE__)
+#define strdup(str) alloc_debug_strdup((str), __FILE__, __LINE__)
+
+#define ALLOC_DEBUG_MARK() (alloc_debug_count)
+#define ALLOC_DEBUG_ASSERT_NONE_SINCE(mark, what) alloc_debug_assert_none_since((mark), (what))
+
+#else
+
+#define ALLOC_DEBUG_MARK() (0u)
+#define ALLOC_DEBUG_ASSERT_NONE_SINCE(mark, what) ((void) (mark))
+
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * cue.h
+ *
+ * Timeline of the cues of the ringing alarm.
+ */
+
+#if !defined(_CUE_H)
+#define _CUE_H
+
+/*
+ * Tracks of the timeline. Each track plays one thing at a time.
+ */
+enum cue_track {
+	CUE_TRACK_VIBRATION = 0,
+	CUE_TRACK_FLASH,
+	CUE_TRACK_POPUP,
+	CUE_TRACK_MAX,
+};
+
+/*
+ * Cue patterns of a ringing alarm. A pattern picks the vibration and the flashing played together.
+ */
+enum cue_pattern {
+	CUE_PATTERN_ALARM = 0,
+	CUE_PATTERN_GENTLE,
+	CUE_PATTERN_AURORA,
+	CUE_PATTERN_MAX,
+};
+
+/*
+ * Runs the events of a track that are due at now.
+ * Returns the time of the next event, or a negative value when the track has ended.
+ */
+typedef double (*cue_track_advance_cb)(double now, void *data);
+
+void cue_timeline_start(enum cue_track track, cue_track_advance_cb advance, void *data);
+void cue_timeline_stop(enum cue_track track);
+void cue_timeline_stop_all(void);
+double cue_timeline_now(void);
+
+#if defined(CUE_HOST)
+void cue_timeline_set_time(double now);
+int cue_timeline_run(double until);
+#endif
+
+#endif
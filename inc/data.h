@@ -17,44 +17,60 @@
 #if !defined(_DATA_H)
 #define _DATA_H
 
+#include <stdint.h>
+
+#define TIME_TEXT_LEN 32
+#define TIME_TEXT_FORMAT "%l:%M %p"
+
 struct genlist_item_data {
 	struct tm saved_time;
+	char time_text[TIME_TEXT_LEN];
 	int alarm_id;
-	char *widget_id;
-	char *instance_id;
+	const char *widget_id;
+	const char *instance_id;
 	Elm_Object_Item *item;
 	Eina_Bool check_state;
+	int state_slot;
+};
+
+struct data_alarm_pool_stats {
+	int live;
+	int peak;
+	int free;
+	int capacity;
+	int slabs;
+	int interned;
 };
 
-#define APP_CONTROL_OPERATION_ALARM_ONTIME "http://tizen.org/appcontrol/operation/my_ontime_alarm"
 #define APP_CONTROL_OPERATION_FROM_WIDGET "launch_request_from_widget"
+#define APP_CONTROL_OPERATION_WIDGET_REFRESH "http://tizen.org/appcontrol/operation/my_widget_refresh"
 
 /*
  * Initialize the data component
  */
 void data_initialize(void);
-void data_initialize_widget_data(void);
 
 void data_initialize_widget_id_in_gendata(void *data);
 /*
  * Finalize the data component
  */
 void data_finalize(void);
-void data_widget_data_finalize(void);
 
 app_control_h data_get_app_control(void);
 bundle *data_get_bundle(void);
-bundle *data_get_widget_data_bundle(void);
 
 void data_get_resource_path(const char *edj_file_in, char *file_path_out, int file_path_max);
 
 char *data_get_title_text(void *data, Evas_Object *obj, const char *part);
 char *data_get_saved_time_text(void *data, Evas_Object *obj, const char *part);
+void data_set_saved_time(struct genlist_item_data *gendata, const struct tm *saved_time);
+void data_update_time_text(struct genlist_item_data *gendata);
+int64_t data_get_saved_epoch(struct genlist_item_data *gendata);
+int data_schedule_alarm(struct genlist_item_data *gendata, int *alarm_id);
 
 bundle *data_create_bundle(void);
 void data_bundle_destroy(bundle *b);
 void data_add_bundle_by_str(const char *bundle_key, const char *bundle_data);
-void data_add_widget_data_bundle_by_str(const char *bundle_key, const char *bundle_data);
 void data_set_widget_alarm_to_preference(const char *widget_id, const char *instance_id);
 void data_set_widget_on_off_to_preference(struct genlist_item_data *gendata, char *on_off, char *alarm_id);
 void data_delete_bundle(const char *key);
@@ -62,8 +78,11 @@ int data_get_bundle_count(void);
 
 struct genlist_item_data *data_alarm_create_genlist_item_data(void);
 void data_alarm_destroy_genlist_item_data(struct genlist_item_data *gendata);
+void data_alarm_pool_get_stats(struct data_alarm_pool_stats *stats);
+void data_alarm_pool_log_stats(void);
 
-char *data_get_popup_text(struct tm *saved_time);
+void data_get_popup_text(const struct tm *saved_time, char *text_out, int text_max);
+int data_format_countdown(time_t target, time_t now, const char *prefix, char *text_out, int text_max);
 void data_set_id_to_gendata(struct genlist_item_data *gendata, const char *widget_id, const char *instance_id);
 Eina_Bool data_check_exist_widget_alarm(struct genlist_item_data *gendata);
 
@@ -0,0 +1,34 @@
+/*
+ * flash.h
+ *
+ * Flashing of the ringing alarm.
+ */
+
+#if !defined(_FLASH_H)
+#define _FLASH_H
+
+#include <Elementary.h>
+
+/*
+ * Precompiled light patterns.
+ */
+enum flash_pattern {
+	FLASH_PATTERN_PULSE = 0,
+	FLASH_PATTERN_AURORA,
+	FLASH_PATTERN_MAX,
+};
+
+/*
+ * Alpha of the flash at a time in the loop of a pattern.
+ * With step set, the alpha holds until the next keyframe instead of fading to it.
+ */
+struct flash_keyframe {
+	unsigned short time_ms;
+	unsigned char alpha;
+	unsigned char step;
+};
+
+void flash_play(Evas_Object *rect, enum flash_pattern pattern);
+void flash_stop(void);
+
+#endif
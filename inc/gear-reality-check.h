@@ -28,6 +28,18 @@
 
 #define BUF_LEN 1024
 
+/*
+ * Operation of the reminders.
+ */
+#define APP_CONTROL_OPERATION_ALARM_ONTIME "http://tizen.org/appcontrol/operation/my_ontime_alarm"
+
+/*
+ * The application the alarm at the start of every day wakes to plan, and the operation of the alarm.
+ * The UI application plans without creating its UI.
+ */
+#define PLANNER_WAKE_APP_ID PACKAGE
+#define APP_CONTROL_OPERATION_PLANNER_WAKE "http://tizen.org/appcontrol/operation/my_planner_wake"
+
 void alarm_destroy_widget(void *user_data);
 void alarm_set_widget_on_off(char *on_off, void *user_data);
 
@@ -0,0 +1,56 @@
+/*
+ * history.h
+ *
+ * Append-only history of what happened to the reminders.
+ */
+
+#if !defined(_HISTORY_H)
+#define _HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "schedule.h"
+
+#define HISTORY_FILE_NAME "history.bin"
+
+/*
+ * What happened to a reminder.
+ */
+enum history_event {
+	HISTORY_EVENT_SHOWN = 0,
+	HISTORY_EVENT_DISMISSED,
+	HISTORY_EVENT_IGNORED,
+	HISTORY_EVENT_MISSED,
+	HISTORY_EVENT_MAX,
+};
+
+struct history_record {
+	int64_t time;
+	enum history_event event;
+	enum schedule_origin origin;
+	unsigned int response_ms;
+};
+
+/*
+ * Called for each record of the history, from the oldest to the latest. Returning false stops the iteration.
+ */
+typedef bool (*history_record_cb)(const struct history_record *record, void *data);
+
+/*
+ * Called after the buffered records have been written at from, with the size of the history file after them.
+ * What lies before from may have been written by the other process.
+ */
+typedef void (*history_flushed_cb)(size_t from, size_t size, void *data);
+
+int history_initialize(const char *path);
+void history_finalize(void);
+int history_append(int64_t time, enum history_event event, enum schedule_origin origin, unsigned int response_ms);
+int history_flush(void);
+int history_foreach(history_record_cb cb, void *data);
+int history_foreach_range(size_t from, size_t to, history_record_cb cb, void *data, size_t *end);
+size_t history_get_size(void);
+void history_set_listener(history_record_cb appended, history_flushed_cb flushed, void *data);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * operation.h
+ *
+ * Dispatch table of the app_control operations.
+ */
+
+#if !defined(_OPERATION_H)
+#define _OPERATION_H
+
+#include <stdint.h>
+#include <app.h>
+
+/*
+ * What a handler needs before it runs.
+ */
+enum operation_need {
+	OPERATION_NEED_NONE = 0,
+	OPERATION_NEED_PLANNER = 1 << 0,
+	OPERATION_NEED_UI = 1 << 1,
+};
+
+typedef void (*operation_handler_cb)(app_control_h app_control, void *user_data);
+
+struct operation_entry {
+	const char *operation;
+	uint32_t hash;
+	int needs;
+	operation_handler_cb handler;
+	void *user_data;
+};
+
+int operation_register(const char *operation, int needs, operation_handler_cb handler, void *user_data);
+const struct operation_entry *operation_find(const char *operation);
+void operation_unregister_all(void);
+uint32_t operation_hash(const char *operation);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * payload.h
+ *
+ * Payload that every scheduled reminder carries in the extra data of its app_control.
+ */
+
+#if !defined(_PAYLOAD_H)
+#define _PAYLOAD_H
+
+#include <stdint.h>
+#include <time.h>
+#include <app_control.h>
+
+#include "schedule.h"
+
+#define APP_CONTROL_DATA_ALARM_PAYLOAD "reminder_payload"
+
+/*
+ * Large enough for every field at its widest.
+ */
+#define ALARM_PAYLOAD_LEN 64
+
+/*
+ * Everything the application needs when the reminder goes off, so it can ring without looking anything up.
+ */
+struct alarm_payload {
+	int64_t epoch;
+	unsigned int plan_generation;
+	int slot;
+	int pattern;
+	enum schedule_origin kind;
+};
+
+int alarm_payload_encode(const struct alarm_payload *payload, char *buf, int buf_len);
+int alarm_payload_decode(const char *text, struct alarm_payload *payload);
+int alarm_payload_schedule(app_control_h app_control, const struct alarm_payload *payload, struct tm *date, int *alarm_id);
+int alarm_payload_read(app_control_h app_control, struct alarm_payload *payload);
+
+#endif
@@ -1,17 +1,49 @@
-/*
- * reality-check.h
- *
- *  Created on: Jan 7, 2018
- *      Author: Florian
- */
-
-#ifndef REALITY_CHECK_H_
-#define REALITY_CHECK_H_
-
-void test();
-
-void start_alarm_vibrate();
-int update_alarms(app_control_h app_control);
-
-
-#endif /* REALITY_CHECK_H_ */
+/*
+ * reality-check.h
+ *
+ *  Created on: Jan 7, 2018
+ *      Author: Florian
+ */
+
+#ifndef REALITY_CHECK_H_
+#define REALITY_CHECK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <app_control.h>
+
+/** The number of days that keep a count of the wake-ups saved by coalescing */
+#define COALESCE_SAVED_DAYS 16
+/** The longest entry of the saved counts, "<day key>:<count>;" with both at the length of the longest int */
+#define COALESCE_SAVED_ENTRY_LEN 24
+/** The length of the saved counts with the terminating null, the longest preference string the planner writes */
+#define COALESCE_SAVED_LEN (COALESCE_SAVED_DAYS * COALESCE_SAVED_ENTRY_LEN + 1)
+
+void test();
+
+int update_alarms(app_control_h app_control);
+int replan_alarms(app_control_h app_control);
+int handle_clock_change(app_control_h app_control);
+int load_schedule();
+int get_planner_wake_alarm_id();
+unsigned int get_plan_generation();
+int get_coalesce_saved(int64_t day);
+int catch_up_missed(int64_t now, int64_t* latest);
+
+int get_streak(int64_t now);
+void mark_reality_check_done(int64_t now);
+
+int get_weekly_quota();
+int set_weekly_quota(app_control_h app_control, int quota);
+int get_remaining_weekly_quota(int64_t now);
+void note_reminder_delivered(int64_t now);
+
+void set_adaptive_sampling(bool adaptive);
+bool is_adaptive_sampling();
+
+void get_reminder_settings(int* num_reminders, struct tm* start, struct tm* end);
+int set_reminder_settings(app_control_h app_control, int num_reminders, const struct tm* start, const struct tm* end);
+
+
+#endif /* REALITY_CHECK_H_ */
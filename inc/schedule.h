@@ -0,0 +1,57 @@
+/*
+ * schedule.h
+ *
+ * Sorted store of the scheduled reminders.
+ */
+
+#if !defined(_SCHEDULE_H)
+#define _SCHEDULE_H
+
+#include <stdint.h>
+
+/*
+ * State of a scheduled reminder.
+ */
+enum schedule_state {
+	SCHEDULE_STATE_PENDING = 0,
+	SCHEDULE_STATE_OFF,
+	SCHEDULE_STATE_DELIVERED,
+	SCHEDULE_STATE_MISSED,
+};
+
+/*
+ * Who scheduled the reminder.
+ */
+enum schedule_origin {
+	SCHEDULE_ORIGIN_PLANNER = 0,
+	SCHEDULE_ORIGIN_USER,
+};
+
+int schedule_store_initialize(void);
+void schedule_store_finalize(void);
+int schedule_store_load_registered(void);
+
+int schedule_store_add(int64_t epoch, int alarm_id, enum schedule_state state, enum schedule_origin origin);
+int schedule_store_remove(int alarm_id);
+int schedule_store_set_state(int alarm_id, enum schedule_state state);
+int schedule_store_find(int alarm_id);
+
+int schedule_store_count(void);
+unsigned int schedule_store_get_generation(void);
+int64_t schedule_store_get_epoch(int index);
+int schedule_store_get_alarm_id(int index);
+enum schedule_state schedule_store_get_state(int index);
+enum schedule_origin schedule_store_get_origin(int index);
+
+int schedule_store_lower_bound(int64_t epoch);
+int schedule_store_next_after(int64_t now);
+int schedule_store_count_in_day(int64_t day);
+int schedule_store_range(int64_t day_from, int64_t day_to, int *first);
+int schedule_store_count_between(int64_t from, int64_t to);
+
+int64_t schedule_day_start(int64_t epoch);
+int64_t schedule_day_next(int64_t day);
+int schedule_day_key(int64_t epoch);
+void schedule_day_cache_rebuild(int64_t now);
+
+#endif
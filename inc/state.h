@@ -0,0 +1,27 @@
+/*
+ * state.h
+ *
+ * On/off state of the alarms shared with the widget.
+ */
+
+#if !defined(_STATE_H)
+#define _STATE_H
+
+#include "data.h"
+
+#define STATE_MAX_SLOTS 64
+
+/*
+ * Called once for every alarm whose state was changed by the widget.
+ */
+typedef void (*state_changed_cb)(struct genlist_item_data *gendata, Eina_Bool on);
+
+int state_record_initialize(state_changed_cb changed_cb);
+void state_record_finalize(void);
+
+int state_record_attach(struct genlist_item_data *gendata, Eina_Bool on);
+void state_record_detach(struct genlist_item_data *gendata);
+void state_record_set(struct genlist_item_data *gendata, Eina_Bool on);
+unsigned int state_record_get_generation(void);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * stats.h
+ *
+ * Rollups of the history of the reminders by hour of day and weekday.
+ */
+
+#if !defined(_STATS_H)
+#define _STATS_H
+
+#include <stdint.h>
+
+#define STATS_FILE_NAME "stats.bin"
+#define STATS_WEEKDAYS 7
+#define STATS_HOURS 24
+
+/*
+ * Selects all weekdays or all hours in stats_get().
+ */
+#define STATS_ALL -1
+
+/*
+ * What the reminders of a set of hours and weekdays came to.
+ */
+struct stats_summary {
+	unsigned int shown;
+	unsigned int dismissed;
+	unsigned int ignored;
+	unsigned int missed;
+	unsigned int response_rate_permille;
+	unsigned int mean_response_ms;
+	unsigned int median_response_ms;
+};
+
+int stats_initialize(const char *path);
+void stats_finalize(void);
+void stats_refresh(void);
+void stats_get(int weekday, int hour, struct stats_summary *summary);
+unsigned int stats_get_generation(void);
+
+#endif
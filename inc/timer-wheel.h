@@ -0,0 +1,47 @@
+/*
+ * timer-wheel.h
+ *
+ * In-app timers on a hierarchical timer wheel.
+ */
+
+#if !defined(_TIMER_WHEEL_H)
+#define _TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/*
+ * Groups of timers that are cancelled together.
+ */
+enum timer_group {
+	TIMER_GROUP_NONE = 0,
+	TIMER_GROUP_RING,
+	TIMER_GROUP_MAX,
+};
+
+typedef void (*timer_wheel_cb)(void *data);
+
+/*
+ * A timer. The owner keeps the memory of the timer, so adding and cancelling never allocates.
+ * The fields are private to the timer wheel.
+ */
+struct timer_wheel_entry {
+	struct timer_wheel_entry *next;
+	struct timer_wheel_entry **pprev;
+	struct timer_wheel_entry *group_next;
+	struct timer_wheel_entry **group_pprev;
+	int64_t expires;
+	int level;
+	int slot;
+	enum timer_group group;
+	timer_wheel_cb cb;
+	void *data;
+};
+
+void timer_wheel_add(struct timer_wheel_entry *entry, double delay, enum timer_group group, timer_wheel_cb cb, void *data);
+void timer_wheel_cancel(struct timer_wheel_entry *entry);
+void timer_wheel_cancel_group(enum timer_group group);
+int timer_wheel_pending(const struct timer_wheel_entry *entry);
+double timer_wheel_align(double time);
+void timer_wheel_finalize(void);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * vibration.h
+ *
+ * Vibration of the ringing alarm.
+ */
+
+#ifndef VIBRATION_H_
+#define VIBRATION_H_
+
+/*
+ * Precompiled vibration patterns.
+ */
+enum vibration_pattern {
+	VIBRATION_PATTERN_ALARM = 0,
+	VIBRATION_PATTERN_GENTLE,
+	VIBRATION_PATTERN_HEARTBEAT,
+	VIBRATION_PATTERN_MAX,
+};
+
+/*
+ * One step of a pattern. A step with intensity 0 is a pause.
+ */
+struct vibration_step {
+	unsigned short duration_ms;
+	unsigned char intensity;
+};
+
+void vibration_play(enum vibration_pattern pattern);
+void vibration_stop(void);
+void vibration_finalize(void);
+
+#endif /* VIBRATION_H_ */
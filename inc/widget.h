@@ -0,0 +1,48 @@
+/*
+ * widget.h
+ *
+ * Updates of the widget.
+ */
+
+#if !defined(_WIDGET_H)
+#define _WIDGET_H
+
+#include <stdint.h>
+
+#include "data.h"
+
+/*
+ * Everything the widget needs to render, so it never has to launch the app.
+ */
+struct widget_payload {
+	int64_t next_epoch;
+	int remaining_today;
+	int streak;
+	char next_text[TIME_TEXT_LEN];
+};
+
+/*
+ * A value of a message to the widget.
+ */
+struct widget_value {
+	const char *key;
+	const char *value;
+};
+
+void widget_registry_initialize(void);
+void widget_registry_finalize(void);
+void widget_registry_add(const char *widget_id, const char *instance_id);
+void widget_registry_remove(const char *instance_id);
+void widget_registry_subscribe(const char *instance_id, int alarm_id);
+void widget_registry_unsubscribe_alarm(int alarm_id);
+void widget_registry_move_alarm(int old_alarm_id, int new_alarm_id);
+void widget_registry_send_for_alarm(int alarm_id, const char *operation, const struct widget_value *values, int count);
+
+void widget_payload_build(struct widget_payload *payload, int64_t now);
+void widget_payload_push(void);
+void widget_payload_invalidate(void);
+
+void widget_queue_flush(void);
+int widget_queue_get_suppressed_count(void);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * alias-table.c
+ *
+ * Walker alias tables for drawing from a discrete distribution in O(1).
+ *
+ * The table is built in O(n) with Vose's method: the weights are scaled so their mean is 1,
+ * then each outcome below 1 is filled up to 1 from an outcome above 1, which becomes its alias.
+ */
+
+#include <stdlib.h>
+#include <tizen_error.h>
+
+#include "alias-table.h"
+
+/*
+ * @brief Builds the alias table of the given weights.
+ * @param[out] table The table
+ * @param[in] weights The weights of the outcomes, not negative
+ * @param[in] num The number of outcomes, at most ALIAS_TABLE_MAX
+ * @return TIZEN_ERROR_NONE, or TIZEN_ERROR_INVALID_PARAMETER if there are too many outcomes or no weight
+ */
+int alias_table_build(struct alias_table *table, const double *weights, int num)
+{
+	double scaled[ALIAS_TABLE_MAX];
+	int small[ALIAS_TABLE_MAX];
+	int large[ALIAS_TABLE_MAX];
+	double sum = 0.0;
+	int num_small = 0;
+	int num_large = 0;
+	int s = 0;
+	int l = 0;
+	int i = 0;
+
+	if (num <= 0 || num > ALIAS_TABLE_MAX) {
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (weights[i] < 0.0) {
+			return TIZEN_ERROR_INVALID_PARAMETER;
+		}
+		sum += weights[i];
+	}
+
+	if (sum <= 0.0) {
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	for (i = 0; i < num; i++) {
+		scaled[i] = weights[i] * num / sum;
+		if (scaled[i] < 1.0) {
+			small[num_small++] = i;
+		} else {
+			large[num_large++] = i;
+		}
+	}
+
+	while (num_small > 0 && num_large > 0) {
+		s = small[--num_small];
+		l = large[--num_large];
+
+		table->prob[s] = scaled[s];
+		table->alias[s] = l;
+
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0) {
+			small[num_small++] = l;
+		} else {
+			large[num_large++] = l;
+		}
+	}
+
+	/*
+	 * What is left is 1 up to rounding errors.
+	 */
+	while (num_large > 0) {
+		l = large[--num_large];
+		table->prob[l] = 1.0;
+		table->alias[l] = l;
+	}
+	while (num_small > 0) {
+		s = small[--num_small];
+		table->prob[s] = 1.0;
+		table->alias[s] = s;
+	}
+
+	table->num = num;
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Draws an outcome from the table, with rand().
+ * @param[in] table The table
+ * @return The index of the outcome
+ */
+int alias_table_draw(const struct alias_table *table)
+{
+	int column = rand() % table->num;
+	double u = rand() / (RAND_MAX + 1.0);
+
+	return u < table->prob[column] ? column : table->alias[column];
+}
+
+/* End of file */
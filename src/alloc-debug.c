@@ -0,0 +1,87 @@
+/*
+ * alloc-debug.c
+ *
+ * Counter of the heap allocations of the application code.
+ *
+ * Only built with ALLOC_DEBUG defined. The counter proves that a path, like ringing an alarm,
+ * does not allocate: the path takes a mark at its start and asserts at its end that the count is the same.
+ */
+
+#if defined(ALLOC_DEBUG)
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "alloc-debug.h"
+
+#undef malloc
+#undef calloc
+#undef realloc
+#undef strdup
+
+unsigned int alloc_debug_count = 0;
+
+static struct alloc_debug_info {
+	const char *file;
+	int line;
+} s_info = {
+	.file = NULL,
+	.line = 0,
+};
+
+static void _count(const char *file, int line)
+{
+	alloc_debug_count++;
+	s_info.file = file;
+	s_info.line = line;
+}
+
+void *alloc_debug_malloc(size_t size, const char *file, int line)
+{
+	_count(file, line);
+
+	return malloc(size);
+}
+
+void *alloc_debug_calloc(size_t count, size_t size, const char *file, int line)
+{
+	_count(file, line);
+
+	return calloc(count, size);
+}
+
+void *alloc_debug_realloc(void *ptr, size_t size, const char *file, int line)
+{
+	_count(file, line);
+
+	return realloc(ptr, size);
+}
+
+char *alloc_debug_strdup(const char *str, const char *file, int line)
+{
+	_count(file, line);
+
+	return strdup(str);
+}
+
+/*
+ * @brief Asserts that nothing was allocated since the mark. The last allocation is logged first.
+ * @param[in] mark The count taken with ALLOC_DEBUG_MARK() at the start of the path
+ * @param[in] what The path, for the log
+ */
+void alloc_debug_assert_none_since(unsigned int mark, const char *what)
+{
+	if (alloc_debug_count != mark) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "%s allocated %u times, last at %s:%d",
+				what, alloc_debug_count - mark, s_info.file, s_info.line);
+	}
+
+	assert(alloc_debug_count == mark);
+}
+
+#endif
+
+/* End of file */
@@ -0,0 +1,355 @@
+/*
+ * cue.c
+ *
+ * Timeline of the cues of the ringing alarm.
+ *
+ * The vibration, the flash and the popup timeout are tracks of one timeline that runs on a single timer
+ * of the timer wheel. The timer wakes at the earliest event of all tracks, rounded up to a frame boundary,
+ * so events of different tracks that fall in the same frame are run by one wake-up.
+ *
+ * With CUE_HOST defined, the timeline runs on a virtual clock and is built as a Linux process, without EFL,
+ * that plays the alarm vibration against the fake haptic device together with a flash and a popup timeout,
+ * and prints every wake-up:
+ *
+ *   gcc -std=gnu99 -DCUE_HOST -Iinc -I<Tizen API headers> src/cue.c src/vibration.c -lm -o cue-host
+ *
+ * The log is printed to stderr.
+ */
+
+#include <tizen_error.h>
+#include <math.h>
+#include <dlog.h>
+
+#if defined(CUE_HOST)
+#include <stdio.h>
+#include <stdarg.h>
+#include "vibration.h"
+#else
+#include <Ecore.h>
+#endif
+
+#include "gear-reality-check.h"
+#include "timer-wheel.h"
+#include "cue.h"
+#include "alloc-debug.h"
+
+#define CUE_FRAME_SECONDS (1.0 / 60.0)
+
+/*
+ * Events this close to the wake-up are run by it, rounding the frame boundary must not skip a frame.
+ */
+#define CUE_EPSILON_SECONDS 1e-6
+
+static struct cue_info {
+	cue_track_advance_cb advance[CUE_TRACK_MAX];
+	void *data[CUE_TRACK_MAX];
+	double deadline[CUE_TRACK_MAX];
+	double origin;
+	double wake_at;
+	int running;
+#if defined(CUE_HOST)
+	double now;
+	int wakes;
+#else
+	struct timer_wheel_entry timer;
+#endif
+} s_info = {
+	.origin = 0.0,
+	.wake_at = -1.0,
+	.running = 0,
+#if defined(CUE_HOST)
+	.now = 0.0,
+	.wakes = 0,
+#endif
+};
+
+static void _run_due(void);
+static void _reschedule(void);
+static double _align(double time);
+static void _arm(double delay);
+static void _disarm(void);
+
+/*
+ * @brief Starts a track, replacing what the track is playing. The first events run right away.
+ * @param[in] track The track
+ * @param[in] advance The function that runs the events of the track
+ * @param[in] data Data passed to advance
+ */
+void cue_timeline_start(enum cue_track track, cue_track_advance_cb advance, void *data)
+{
+	double now = cue_timeline_now();
+
+	if (track < 0 || track >= CUE_TRACK_MAX || advance == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Invalid cue track %d", track);
+		return;
+	}
+
+	/*
+	 * On the virtual clock, frames are counted from the first cue, when nothing else is playing.
+	 */
+	if (s_info.running == 0) {
+		s_info.origin = now;
+	}
+
+	if (s_info.advance[track] == NULL) {
+		s_info.running++;
+	}
+
+	s_info.advance[track] = advance;
+	s_info.data[track] = data;
+	s_info.deadline[track] = now;
+
+	_run_due();
+}
+
+/*
+ * @brief Stops a track. The events of the track that have not run are dropped.
+ * @param[in] track The track
+ */
+void cue_timeline_stop(enum cue_track track)
+{
+	if (track < 0 || track >= CUE_TRACK_MAX || s_info.advance[track] == NULL) {
+		return;
+	}
+
+	s_info.advance[track] = NULL;
+	s_info.data[track] = NULL;
+	s_info.running--;
+
+	_reschedule();
+}
+
+/*
+ * @brief Stops every track.
+ */
+void cue_timeline_stop_all(void)
+{
+	int track = 0;
+
+	for (track = 0; track < CUE_TRACK_MAX; track++) {
+		cue_timeline_stop(track);
+	}
+}
+
+/*
+ * @brief Monotonic time in seconds, the time of the timeline.
+ */
+double cue_timeline_now(void)
+{
+#if defined(CUE_HOST)
+	return s_info.now;
+#else
+	return ecore_time_get();
+#endif
+}
+
+/*
+ * @note Below functions are static functions.
+ */
+
+/*
+ * @brief Runs the tracks whose events are due, then sets the timer to the next event.
+ * An advance function may stop or start tracks, so a track is checked again before it runs.
+ */
+static void _run_due(void)
+{
+	cue_track_advance_cb advance = NULL;
+	double now = cue_timeline_now();
+	double deadline = 0.0;
+	int track = 0;
+
+	for (track = 0; track < CUE_TRACK_MAX; track++) {
+		advance = s_info.advance[track];
+		if (advance == NULL || s_info.deadline[track] > now + CUE_EPSILON_SECONDS) {
+			continue;
+		}
+
+		deadline = advance(now, s_info.data[track]);
+		if (s_info.advance[track] != advance) {
+			continue;
+		}
+
+		if (deadline < 0.0) {
+			s_info.advance[track] = NULL;
+			s_info.data[track] = NULL;
+			s_info.running--;
+		} else {
+			s_info.deadline[track] = deadline;
+		}
+	}
+
+	_reschedule();
+}
+
+/*
+ * @brief Sets the timer to the first frame boundary at or after the earliest event.
+ */
+static void _reschedule(void)
+{
+	double earliest = -1.0;
+	double wake_at = 0.0;
+	int track = 0;
+
+	for (track = 0; track < CUE_TRACK_MAX; track++) {
+		if (s_info.advance[track] && (earliest < 0.0 || s_info.deadline[track] < earliest)) {
+			earliest = s_info.deadline[track];
+		}
+	}
+
+	if (earliest < 0.0) {
+		_disarm();
+		return;
+	}
+
+	wake_at = _align(earliest);
+	if (wake_at == s_info.wake_at) {
+		return;
+	}
+
+	_disarm();
+	s_info.wake_at = wake_at;
+	_arm(wake_at - cue_timeline_now());
+}
+
+#if !defined(CUE_HOST)
+
+/*
+ * @brief Frames are the ticks of the timer wheel.
+ */
+static double _align(double time)
+{
+	return timer_wheel_align(time);
+}
+
+static void _timer_cb(void *data)
+{
+	s_info.wake_at = -1.0;
+	_run_due();
+}
+
+static void _arm(double delay)
+{
+	timer_wheel_add(&s_info.timer, delay, TIMER_GROUP_NONE, _timer_cb, NULL);
+}
+
+static void _disarm(void)
+{
+	timer_wheel_cancel(&s_info.timer);
+	s_info.wake_at = -1.0;
+}
+
+#else
+
+/*
+ * @brief Frames are counted from the first cue.
+ */
+static double _align(double time)
+{
+	return s_info.origin + ceil((time - s_info.origin) / CUE_FRAME_SECONDS - CUE_EPSILON_SECONDS) * CUE_FRAME_SECONDS;
+}
+
+static void _arm(double delay)
+{
+}
+
+static void _disarm(void)
+{
+	s_info.wake_at = -1.0;
+}
+
+/*
+ * @brief Sets the virtual clock.
+ */
+void cue_timeline_set_time(double now)
+{
+	s_info.now = now;
+}
+
+/*
+ * @brief Moves the virtual clock from wake-up to wake-up, like the timer would, until nothing plays or until is reached.
+ * @return The number of wake-ups
+ */
+int cue_timeline_run(double until)
+{
+	int wakes = 0;
+
+	while (s_info.wake_at >= 0.0 && s_info.wake_at <= until) {
+		s_info.now = s_info.wake_at;
+		s_info.wake_at = -1.0;
+		wakes++;
+		_run_due();
+	}
+
+	return wakes;
+}
+
+/*
+ * A flash with step keyframes every 300 ms, it has an event at each change only.
+ * Its changes at 600 ms and 1200 ms share the wake-ups of the vibration.
+ */
+static double _flash_advance(double now, void *data)
+{
+	int *changes = data;
+
+	printf("%8.1f ms flash %s\n", now * 1000.0, *changes % 2 ? "off" : "on");
+	(*changes)++;
+
+	return *changes < 8 ? now + 0.3 : -1.0;
+}
+
+static double _popup_advance(double now, void *data)
+{
+	static int shown = 0;
+
+	if (!shown) {
+		shown = 1;
+		return now + 2.0;
+	}
+
+	printf("%8.1f ms popup timeout\n", now * 1000.0);
+
+	return -1.0;
+}
+
+int dlog_print(log_priority prio, const char *tag, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (prio < DLOG_INFO) {
+		return 0;
+	}
+
+	va_start(ap, fmt);
+	fprintf(stderr, "%s: ", tag);
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+
+	return 0;
+}
+
+/*
+ * @brief Plays the alarm cues and prints the events with the wake-ups that ran them.
+ */
+int main(int argc, char *argv[])
+{
+	int flash_changes = 0;
+	int wakes = 0;
+
+	cue_timeline_set_time(0.0);
+	vibration_play(VIBRATION_PATTERN_ALARM);
+	cue_timeline_start(CUE_TRACK_FLASH, _flash_advance, &flash_changes);
+	cue_timeline_start(CUE_TRACK_POPUP, _popup_advance, NULL);
+
+	wakes = cue_timeline_run(10.0);
+
+	vibration_finalize();
+
+	printf("%d wake-ups\n", wakes);
+
+	return 0;
+}
+
+#endif
+
+/* End of file */
@@ -20,32 +20,81 @@
 #include <bundle.h>
 #include <app_preference.h>
 #include <app.h>
+#include <app_alarm.h>
 #include <widget_service.h>
 #include <widget_errno.h>
 
 #include "gear-reality-check.h"
 #include "data.h"
 #include "view.h"
+#include "state.h"
+#include "schedule.h"
+#include "reality-check.h"
+#include "cue.h"
+#include "payload.h"
 
 static struct data_info {
 	app_control_h app_control;
 	bundle *b;
-	bundle *widget_data_b;
 } s_info = {
 	.app_control = NULL,
 	.b = NULL,
-	.widget_data_b = NULL,
+};
+
+/*
+ * Records of alarms are taken from slabs of ALARM_POOL_SLAB_SIZE records,
+ * at most ALARM_POOL_MAX_SLABS slabs are allocated.
+ */
+#define ALARM_POOL_SLAB_SIZE 32
+#define ALARM_POOL_MAX_SLABS 8
+#define INTERN_TABLE_SIZE 16
+
+union alarm_pool_node {
+	struct genlist_item_data gendata;
+	union alarm_pool_node *next_free;
+};
+
+struct interned_string {
+	char *str;
+	int ref_count;
+};
+
+static struct alarm_pool_info {
+	union alarm_pool_node *slabs[ALARM_POOL_MAX_SLABS];
+	int slab_count;
+	int bump;
+	union alarm_pool_node *free_list;
+	int free_count;
+	int live_count;
+	int peak_count;
+	struct interned_string strings[INTERN_TABLE_SIZE];
+} s_pool = {
+	.slabs = { NULL, },
+	.slab_count = 0,
+	.bump = ALARM_POOL_SLAB_SIZE,
+	.free_list = NULL,
+	.free_count = 0,
+	.live_count = 0,
+	.peak_count = 0,
+	.strings = { { NULL, 0 }, },
 };
 
 #define HOURS_A_DAY 24
 #define MINS_AN_HOUR 60
+#define SECS_A_MIN 60
 #define ALARM_SET_FOR "Alarm set for"
+#define DAY "day"
 #define HOUR "hour"
 #define MINUTE "minute"
 
 static app_control_h _create_app_control(const char *operation, const char *app_id);
 static void _destroy_app_control(app_control_h app_control);
 static bundle *_decode_bundle(void);
+static int _append_countdown_unit(char *text_out, int text_max, int len, long value, const char *unit);
+static const char *_intern_string(const char *str);
+static void _release_string(const char *str);
+static void _alarm_pool_finalize(void);
+static void _roll_to_future(struct tm *alarm_time);
 
 /*
  * @brief Initialize data that is used in this application.
@@ -91,32 +140,39 @@ void data_initialize_widget_id_in_gendata(void *data)
 		return;
 	}
 
+	_release_string(gendata->widget_id);
 	gendata->widget_id = NULL;
 }
 
 /*
- * @brief Initialize widget data that is used in this application.
+ * @brief Sets the IDs of the widget the alarm belongs to.
+ * The IDs are interned, so all alarms of a widget share the same strings.
+ * @param[in] gendata Data structure that stores information of genlist, such as saved time, alarm ID, check state
+ * @param[in] widget_id ID of the widget
+ * @param[in] instance_id ID of the widget instance
  */
-void data_initialize_widget_data(void)
+void data_set_id_to_gendata(struct genlist_item_data *gendata, const char *widget_id, const char *instance_id)
 {
-	if (s_info.widget_data_b) {
-		data_bundle_destroy(s_info.widget_data_b);
-	}
+	const char *new_widget_id = NULL;
+	const char *new_instance_id = NULL;
 
-	s_info.widget_data_b = bundle_create();
-	if (s_info.widget_data_b == NULL) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to create a widget data bundle.");
+	if (gendata == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] gendata is NULL", __func__, __LINE__);
 		return;
 	}
-}
 
-/*
- * @brief Destroys widget data that is used in this application.
- */
-void data_widget_data_finalize(void)
-{
-	data_bundle_destroy(s_info.widget_data_b);
-	s_info.widget_data_b = NULL;
+	/*
+	 * Intern the new strings before releasing the old ones, they may be the same.
+	 */
+	new_widget_id = _intern_string(widget_id);
+	new_instance_id = _intern_string(instance_id);
+
+	state_record_detach(gendata);
+	_release_string(gendata->widget_id);
+	_release_string(gendata->instance_id);
+
+	gendata->widget_id = new_widget_id;
+	gendata->instance_id = new_instance_id;
 }
 
 /*
@@ -134,6 +190,9 @@ void data_finalize(void)
 
 	_destroy_app_control(s_info.app_control);
 	s_info.app_control = NULL;
+
+	data_alarm_pool_log_stats();
+	_alarm_pool_finalize();
 }
 
 /*
@@ -152,14 +211,6 @@ bundle *data_get_bundle(void)
 	return s_info.b;
 }
 
-/*
- * @brief Gets bundle will be used for widget data.
- */
-bundle *data_get_widget_data_bundle(void)
-{
-	return s_info.widget_data_b;
-}
-
 /*
  * @brief Gets path of resource.
  * @param[in] file_in File name
@@ -198,18 +249,103 @@ char *data_get_title_text(void *data, Evas_Object *obj, const char *part)
 char *data_get_saved_time_text(void *data, Evas_Object *obj, const char *part)
 {
 	struct genlist_item_data *gendata = data;
-	struct tm *saved_time = NULL;
-	char buf[BUF_LEN] = { 0, };
 
+	/*
+	 * The text is formatted when the time is set, so realizing an item only copies it.
+	 * Genlist frees the returned string, therefore it has to be duplicated here.
+	 */
 	if (!strcmp(part, "elm.text")) {
-		saved_time = &gendata->saved_time;
-		strftime(buf, sizeof(buf) - 1, "%l:%M %p", saved_time);
-		return strdup(buf);
+		return strdup(gendata->time_text);
 	}
 
 	return NULL;
 }
 
+/*
+ * @brief Stores the time of the alarm and formats the text shown for it.
+ * A time of day that has already passed today is taken for tomorrow.
+ * @param[in] gendata Data structure that stores information of genlist, such as saved time, alarm ID, check state
+ * @param[in] saved_time Time that user sets
+ */
+void data_set_saved_time(struct genlist_item_data *gendata, const struct tm *saved_time)
+{
+	if (gendata == NULL || saved_time == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] gendata or saved_time is NULL", __func__, __LINE__);
+		return;
+	}
+
+	gendata->saved_time = *saved_time;
+	_roll_to_future(&gendata->saved_time);
+	data_update_time_text(gendata);
+}
+
+/*
+ * @brief Gets the saved time in seconds since the epoch.
+ * @param[in] gendata Data structure that stores information of genlist, such as saved time, alarm ID, check state
+ */
+int64_t data_get_saved_epoch(struct genlist_item_data *gendata)
+{
+	struct tm saved_time;
+
+	if (gendata == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] gendata is NULL", __func__, __LINE__);
+		return -1;
+	}
+
+	/*
+	 * mktime() normalizes its argument, so work on a copy.
+	 */
+	saved_time = gendata->saved_time;
+	saved_time.tm_isdst = -1;
+
+	return (int64_t) mktime(&saved_time);
+}
+
+/*
+ * @brief Schedules the alarm at its saved time. The alarm carries its payload, so it rings without a lookup.
+ * @param[in] gendata Data structure that stores information of genlist, such as saved time, alarm ID, check state
+ * @param[out] alarm_id The ID of the scheduled alarm
+ * @return ALARM_ERROR_NONE, or the error of the alarm API
+ */
+int data_schedule_alarm(struct genlist_item_data *gendata, int *alarm_id)
+{
+	struct alarm_payload payload;
+
+	if (gendata == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] gendata is NULL", __func__, __LINE__);
+		return ALARM_ERROR_INVALID_PARAMETER;
+	}
+
+	/*
+	 * An alarm switched back on may have been set days ago.
+	 */
+	_roll_to_future(&gendata->saved_time);
+
+	payload.epoch = data_get_saved_epoch(gendata);
+	payload.plan_generation = get_plan_generation();
+	payload.slot = -1;
+	payload.pattern = CUE_PATTERN_ALARM;
+	payload.kind = SCHEDULE_ORIGIN_USER;
+
+	return alarm_payload_schedule(s_info.app_control, &payload, &gendata->saved_time, alarm_id);
+}
+
+/*
+ * @brief Formats the text of the saved time again, e.g. after the language has been changed.
+ * @param[in] gendata Data structure that stores information of genlist, such as saved time, alarm ID, check state
+ */
+void data_update_time_text(struct genlist_item_data *gendata)
+{
+	if (gendata == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] gendata is NULL", __func__, __LINE__);
+		return;
+	}
+
+	if (strftime(gendata->time_text, sizeof(gendata->time_text), TIME_TEXT_FORMAT, &gendata->saved_time) == 0) {
+		gendata->time_text[0] = '\0';
+	}
+}
+
 /*
  * @brief Creates a bundle.
  */
@@ -280,25 +416,6 @@ void data_add_bundle_by_str(const char *bundle_key, const char *bundle_data)
 	}
 }
 
-/*
- * @brief Adds a bundle for widget with string type key-value
- * @param[in] bundle_key Key that uniquely identifies a bundle
- * @param[in] bundle_data Data that stores bundle as string type value
- */
-void data_add_widget_data_bundle_by_str(const char *bundle_key, const char *bundle_data)
-{
-	if (s_info.widget_data_b == NULL) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "bundle is NULL.");
-		return;
-	}
-
-	dlog_print(DLOG_INFO, LOG_TAG, "widget_bundle:%p, key(%s), data(%s)", s_info.widget_data_b, bundle_key, bundle_data);
-
-	if (BUNDLE_ERROR_NONE != bundle_add_str(s_info.widget_data_b, bundle_key, bundle_data)) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed at bundle_add_str(). Can't add bundle by using string.");
-	}
-}
-
 /*
  * @brief Removes a key-value object with the given key
  * @param[in] key Key that uniquely identifies a bundle
@@ -335,23 +452,6 @@ void data_delete_bundle(const char *key)
 	}
 }
 
-/*
- * @brief Removes a key-value object with the given key.
- * @param[in] key Key that uniquely identifies a bundle
- */
-void data_delete_widget_data_bundle(const char *key)
-{
-	if (s_info.widget_data_b == NULL) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "bundle is NULL.");
-		return;
-	}
-
-	if (BUNDLE_ERROR_NONE != bundle_del(s_info.widget_data_b, key)) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed at bundle_del(). Can't delete bundle.");
-		return;
-	}
-}
-
 /*
  * @brief Gets the number of bundle items.
  */
@@ -371,19 +471,47 @@ int data_get_bundle_count(void)
 
 /*
  * @brief Allocates for data of genlist's items.
+ * Records are taken from the free list first, then from the current slab.
+ * A new slab is only allocated when both are exhausted.
  */
 struct genlist_item_data *data_alarm_create_genlist_item_data(void)
 {
-	struct genlist_item_data *gendata;
+	union alarm_pool_node *node = NULL;
+	struct genlist_item_data *gendata = NULL;
 
-	gendata = malloc(sizeof(struct genlist_item_data));
-	if (gendata == NULL) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "gendata cannot be allocated.");
-		return NULL;
+	if (s_pool.free_list) {
+		node = s_pool.free_list;
+		s_pool.free_list = node->next_free;
+		s_pool.free_count--;
+	} else {
+		if (s_pool.bump == ALARM_POOL_SLAB_SIZE) {
+			if (s_pool.slab_count == ALARM_POOL_MAX_SLABS) {
+				dlog_print(DLOG_ERROR, LOG_TAG, "gendata cannot be allocated, the pool is full.");
+				return NULL;
+			}
+
+			s_pool.slabs[s_pool.slab_count] = malloc(sizeof(union alarm_pool_node) * ALARM_POOL_SLAB_SIZE);
+			if (s_pool.slabs[s_pool.slab_count] == NULL) {
+				dlog_print(DLOG_ERROR, LOG_TAG, "gendata cannot be allocated.");
+				return NULL;
+			}
+
+			s_pool.slab_count++;
+			s_pool.bump = 0;
+		}
+
+		node = &s_pool.slabs[s_pool.slab_count - 1][s_pool.bump++];
 	}
 
+	s_pool.live_count++;
+	if (s_pool.live_count > s_pool.peak_count) {
+		s_pool.peak_count = s_pool.live_count;
+	}
+
+	gendata = &node->gendata;
+	memset(gendata, 0, sizeof(*gendata));
 	gendata->check_state = EINA_TRUE;
-	gendata->instance_id = NULL;
+	gendata->state_slot = -1;
 
 	return gendata;
 }
@@ -394,103 +522,148 @@ struct genlist_item_data *data_alarm_create_genlist_item_data(void)
  */
 void data_alarm_destroy_genlist_item_data(struct genlist_item_data *gendata)
 {
+	union alarm_pool_node *node = NULL;
+
 	if (gendata == NULL) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "gendata is NULL.");
 		return;
 	}
 
-	if (gendata->widget_id) {
-		free(gendata->widget_id);
+	state_record_detach(gendata);
+	_release_string(gendata->widget_id);
+	_release_string(gendata->instance_id);
+
+	/*
+	 * gendata is the first member of the node, so the record is pushed to the free list as it is.
+	 */
+	node = (union alarm_pool_node *) gendata;
+	node->next_free = s_pool.free_list;
+	s_pool.free_list = node;
+	s_pool.free_count++;
+	s_pool.live_count--;
+}
+
+/*
+ * @brief Gets statistics of the pool of alarm records.
+ * @param[out] stats The statistics
+ */
+void data_alarm_pool_get_stats(struct data_alarm_pool_stats *stats)
+{
+	int i;
+
+	if (stats == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "stats is NULL.");
+		return;
 	}
 
-	if (gendata->instance_id) {
-		free(gendata->instance_id);
+	stats->live = s_pool.live_count;
+	stats->peak = s_pool.peak_count;
+	stats->free = s_pool.free_count;
+	stats->slabs = s_pool.slab_count;
+	stats->capacity = s_pool.slab_count * ALARM_POOL_SLAB_SIZE;
+	stats->interned = 0;
+
+	for (i = 0; i < INTERN_TABLE_SIZE; i++) {
+		if (s_pool.strings[i].str) {
+			stats->interned++;
+		}
 	}
+}
+
+/*
+ * @brief Logs statistics of the pool of alarm records.
+ * Fragmentation is the share of released records among the records that have been handed out.
+ */
+void data_alarm_pool_log_stats(void)
+{
+	struct data_alarm_pool_stats stats;
+	int used = 0;
+
+	data_alarm_pool_get_stats(&stats);
+	used = stats.live + stats.free;
 
-	free(gendata);
+	dlog_print(DLOG_INFO, LOG_TAG, "Alarm pool: live(%d), peak(%d), free(%d), capacity(%d), slabs(%d), interned(%d), fragmentation(%d%%)",
+			stats.live, stats.peak, stats.free, stats.capacity, stats.slabs, stats.interned,
+			used ? stats.free * 100 / used : 0);
 }
+
 /*
  * @brief Gets popup's text when the popup shows.
  * @param[in] saved_time Time that user sets
+ * @param[out] text_out The buffer to which the text is written
+ * @param[in] text_max Size of the buffer
  */
-char *data_get_popup_text(struct tm *saved_time)
+void data_get_popup_text(const struct tm *saved_time, char *text_out, int text_max)
 {
-	time_t t;
-	struct tm *current_time;
-	int hour_val, min_val;
-	char time_text[BUF_LEN] = { 0, };
+	struct tm alarm_time;
 
-	if (saved_time == NULL) {
+	if (saved_time == NULL || text_out == NULL || text_max <= 0) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "failed to get saved time.");
-		return NULL;
+		return;
 	}
 
 	/*
-	 * Do the following steps.
-	 * 1. Get current time
-	 * 2. Calculate the rest of time until the alarm rings compared with saved time.
+	 * mktime() normalizes its argument, so work on a copy.
+	 * Let it figure out whether DST is in effect at the alarm time.
 	 */
+	alarm_time = *saved_time;
+	alarm_time.tm_isdst = -1;
 
-	t = time(NULL);
-	current_time = localtime(&t);
+	data_format_countdown(mktime(&alarm_time), time(NULL), ALARM_SET_FOR, text_out, text_max);
 
-	hour_val = saved_time->tm_hour - current_time->tm_hour;
-	min_val = saved_time->tm_min - current_time->tm_min;
+	dlog_print(DLOG_INFO, LOG_TAG, "Popup text : %s", text_out);
+}
 
-	if (hour_val == 0) {
-		if (min_val == 0) {
-			snprintf(time_text, sizeof(time_text), "%s", "Time is now.");
-		} else if (min_val > 0) {
-			snprintf(time_text, sizeof(time_text), "%s %d %s %s", ALARM_SET_FOR, min_val, MINUTE, "from now.");
-		} else {
-			/* min_val < 0 */
-			int val;
+/*
+ * @brief Formats the time left until the target time, e.g. "Alarm set for 1 day 2 hours 5 minutes from now."
+ * Both times are seconds since the epoch, so the result is also correct across days and DST changes.
+ * It does not allocate, therefore it can also be used to update a countdown every tick.
+ * @param[in] target Time the countdown ends
+ * @param[in] now Current time
+ * @param[in] prefix Text that is put before the time left
+ * @param[out] text_out The buffer to which the text is written
+ * @param[in] text_max Size of the buffer
+ * @return The length of the formatted text, or -1 on invalid parameters
+ */
+int data_format_countdown(time_t target, time_t now, const char *prefix, char *text_out, int text_max)
+{
+	double diff = 0.0;
+	long mins = 0;
+	long hours = 0;
+	long days = 0;
+	int len = 0;
 
-			val = (MINS_AN_HOUR - current_time->tm_min) + saved_time->tm_min;
-			snprintf(time_text, sizeof(time_text), "%s %d %s %s", "Alarm set for 23 hours", val, MINUTE, "from now.");
-		}
-	} else if (hour_val > 0) {
-		if (min_val == 0) {
-			snprintf(time_text, sizeof(time_text), "%s %d %s %s", ALARM_SET_FOR, hour_val, HOUR, "from now.");
-		} else if (min_val > 0) {
-			snprintf(time_text, sizeof(time_text), "%s %d %s %d %s %s", ALARM_SET_FOR, hour_val, HOUR, min_val, MINUTE, "from now.");
-		} else {
-			/* min_val < 0 */
-			int val;
-
-			val = (MINS_AN_HOUR - current_time->tm_min) + saved_time->tm_min;
-			if (hour_val == 0) {
-				snprintf(time_text, sizeof(time_text), "%s %d %s %s", ALARM_SET_FOR, val, MINUTE, "from now.");
-			} else {
-				snprintf(time_text, sizeof(time_text), "%s %d %s %d %s %s", ALARM_SET_FOR, hour_val - 1, HOUR, val, MINUTE, "from now.");
-			}
-		}
-	} else {
-		/* hour_val < 0 */
-		if (min_val == 0) {
-			int val;
+	if (prefix == NULL || text_out == NULL || text_max <= 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] invalid parameter", __func__, __LINE__);
+		return -1;
+	}
 
-			val = (HOURS_A_DAY - current_time->tm_hour) + saved_time->tm_hour;
-			snprintf(time_text, sizeof(time_text), "%s %d %s %s", ALARM_SET_FOR, val, HOUR, "from now.");
-		} else if (min_val > 0) {
-			int val;
+	diff = difftime(target, now);
+	if (diff < 0) {
+		return snprintf(text_out, text_max, "%s", "Time has passed.");
+	}
 
-			val = (HOURS_A_DAY - current_time->tm_hour) + saved_time->tm_hour;
-			snprintf(time_text, sizeof(time_text), "%s %d %s %d %s %s", ALARM_SET_FOR, val, HOUR, min_val, MINUTE, "from now.");
-		} else {
-			/* min_val < 0 */
-			int h_val, m_val;
+	/*
+	 * Round up to whole minutes, so the alarm never rings before the shown time is over.
+	 */
+	mins = (long) ((diff + SECS_A_MIN - 1) / SECS_A_MIN);
+	if (mins == 0) {
+		return snprintf(text_out, text_max, "%s", "Time is now.");
+	}
 
-			h_val = (HOURS_A_DAY - current_time->tm_hour) + saved_time->tm_hour;
-			m_val = (MINS_AN_HOUR - current_time->tm_min) + saved_time->tm_min;
+	days = mins / (HOURS_A_DAY * MINS_AN_HOUR);
+	hours = (mins / MINS_AN_HOUR) % HOURS_A_DAY;
+	mins = mins % MINS_AN_HOUR;
 
-			snprintf(time_text, sizeof(time_text), "%s %d %s %d %s %s", ALARM_SET_FOR, h_val - 1, HOUR, m_val, MINUTE, "from now.");
-		}
+	len = snprintf(text_out, text_max, "%s", prefix);
+	len = _append_countdown_unit(text_out, text_max, len, days, DAY);
+	len = _append_countdown_unit(text_out, text_max, len, hours, HOUR);
+	len = _append_countdown_unit(text_out, text_max, len, mins, MINUTE);
+	if (len < text_max) {
+		len += snprintf(text_out + len, text_max - len, " %s", "from now.");
 	}
 
-	dlog_print(DLOG_INFO, LOG_TAG, "Popup text : %s", time_text);
-
-	return strdup(time_text);
+	return len;
 }
 
 /*
@@ -566,6 +739,113 @@ static bundle *_decode_bundle(void)
 	return b;
 }
 
+/*
+ * @brief Appends a value with its unit to a countdown text. Nothing is appended for zero values.
+ * @param[out] text_out The buffer to which the text is written
+ * @param[in] text_max Size of the buffer
+ * @param[in] len The length of the text already in the buffer
+ * @param[in] value The value to append
+ * @param[in] unit The unit of the value in singular
+ * @return The length of the text after appending
+ */
+static int _append_countdown_unit(char *text_out, int text_max, int len, long value, const char *unit)
+{
+	if (value == 0 || len >= text_max) {
+		return len;
+	}
+
+	return len + snprintf(text_out + len, text_max - len, " %ld %s%s", value, unit, value == 1 ? "" : "s");
+}
+
+/*
+ * @brief Gets the shared copy of the string, adding it to the intern table if needed.
+ * @param[in] str The string to intern
+ * @return The interned string, or NULL if str is NULL or the table is full
+ */
+static const char *_intern_string(const char *str)
+{
+	int free_slot = -1;
+	int i;
+
+	if (str == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i < INTERN_TABLE_SIZE; i++) {
+		if (s_pool.strings[i].str == NULL) {
+			if (free_slot < 0) {
+				free_slot = i;
+			}
+		} else if (!strcmp(s_pool.strings[i].str, str)) {
+			s_pool.strings[i].ref_count++;
+			return s_pool.strings[i].str;
+		}
+	}
+
+	if (free_slot < 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to intern string, the table is full.");
+		return NULL;
+	}
+
+	s_pool.strings[free_slot].str = strdup(str);
+	if (s_pool.strings[free_slot].str == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to intern string.");
+		return NULL;
+	}
+	s_pool.strings[free_slot].ref_count = 1;
+
+	return s_pool.strings[free_slot].str;
+}
+
+/*
+ * @brief Releases a string got from _intern_string(). It is freed when nothing refers to it anymore.
+ * @param[in] str The interned string
+ */
+static void _release_string(const char *str)
+{
+	int i;
+
+	if (str == NULL) {
+		return;
+	}
+
+	for (i = 0; i < INTERN_TABLE_SIZE; i++) {
+		if (s_pool.strings[i].str == str) {
+			if (--s_pool.strings[i].ref_count == 0) {
+				free(s_pool.strings[i].str);
+				s_pool.strings[i].str = NULL;
+			}
+			return;
+		}
+	}
+
+	dlog_print(DLOG_ERROR, LOG_TAG, "String is not interned.");
+}
+
+/*
+ * @brief Frees the slabs of the pool of alarm records.
+ * Slabs are kept if there are still records in use, e.g. when genlist's items have not been deleted.
+ */
+static void _alarm_pool_finalize(void)
+{
+	int i;
+
+	if (s_pool.live_count) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "%d alarm records are still in use.", s_pool.live_count);
+		return;
+	}
+
+	for (i = 0; i < s_pool.slab_count; i++) {
+		free(s_pool.slabs[i]);
+		s_pool.slabs[i] = NULL;
+	}
+
+	s_pool.slab_count = 0;
+	s_pool.bump = ALARM_POOL_SLAB_SIZE;
+	s_pool.free_list = NULL;
+	s_pool.free_count = 0;
+}
+
 /*
  * @brief Checks whether alarm is exist.
  * @param[in] gendata Data structure that stores information of genlist, such as saved time, alarm ID, check state
@@ -581,4 +861,31 @@ Eina_Bool data_check_exist_widget_alarm(struct genlist_item_data *gendata)
 	}
 }
 
+/*
+ * @brief Moves the time of day to its next occurrence: today, or tomorrow if it has passed.
+ * @param[in,out] alarm_time The time of the alarm; only its time of day is kept
+ */
+static void _roll_to_future(struct tm *alarm_time)
+{
+	time_t now = time(NULL);
+	struct tm next;
+
+	localtime_r(&now, &next);
+	next.tm_hour = alarm_time->tm_hour;
+	next.tm_min = alarm_time->tm_min;
+	next.tm_sec = alarm_time->tm_sec;
+	next.tm_isdst = -1;
+
+	if (mktime(&next) <= now) {
+		/*
+		 * mktime() normalizes the day past the end of the month.
+		 */
+		next.tm_mday++;
+		next.tm_isdst = -1;
+		mktime(&next);
+	}
+
+	*alarm_time = next;
+}
+
 /* End of file */
@@ -0,0 +1,165 @@
+/*
+ * flash.c
+ *
+ * Flashing of the ringing alarm.
+ *
+ * Patterns are keyframe tables that loop for a duration. The alpha is evaluated against the monotonic time
+ * elapsed since the start, so a late frame does not slow the pattern down, and the rectangle is only
+ * recolored when the alpha changes. The flash is a track of the cue timeline. A fade has an event at every
+ * frame of the frame rate its pattern declares, a step has one event at the next keyframe.
+ */
+
+#include <tizen_error.h>
+#include <dlog.h>
+#include <Elementary.h>
+
+#include "gear-reality-check.h"
+#include "cue.h"
+#include "flash.h"
+#include "alloc-debug.h"
+
+#define COUNT_OF(array) (sizeof(array) / sizeof((array)[0]))
+
+/*
+ * White to transparent and back, the flash the alarm always had.
+ */
+static const struct flash_keyframe s_pattern_pulse[] = {
+	{ 0, 255, 0 }, { 200, 0, 0 }, { 400, 255, 0 },
+};
+
+/*
+ * Hard 2 Hz blinks in bursts, like the light cues of a lucid dreaming mask.
+ */
+static const struct flash_keyframe s_pattern_aurora[] = {
+	{ 0, 255, 1 }, { 250, 0, 1 }, { 500, 255, 1 }, { 750, 0, 1 }, { 1000, 255, 1 }, { 1250, 0, 1 },
+	{ 2000, 0, 1 },
+};
+
+static const struct flash_pattern_table {
+	const struct flash_keyframe *keyframes;
+	int num_keyframes;
+	int period_ms;
+	int duration_ms;
+	int fps;
+} s_patterns[FLASH_PATTERN_MAX] = {
+	[FLASH_PATTERN_PULSE] = { s_pattern_pulse, COUNT_OF(s_pattern_pulse), 400, 1000, 30 },
+	[FLASH_PATTERN_AURORA] = { s_pattern_aurora, COUNT_OF(s_pattern_aurora), 2000, 6000, 4 },
+};
+
+static struct flash_info {
+	Evas_Object *rect;
+	const struct flash_pattern_table *pattern;
+	double started;
+	int alpha;
+} s_info = {
+	.rect = NULL,
+	.pattern = NULL,
+	.started = 0.0,
+	.alpha = -1,
+};
+
+static int _evaluate(const struct flash_pattern_table *pattern, int elapsed_ms, int *next_ms);
+static double _advance(double now, void *data);
+
+/*
+ * @brief Plays a pattern on a rectangle, replacing the pattern that is playing.
+ * @param[in] rect The rectangle to flash, it is hidden when the pattern ends
+ * @param[in] pattern The pattern to play
+ */
+void flash_play(Evas_Object *rect, enum flash_pattern pattern)
+{
+	if (rect == NULL || pattern < 0 || pattern >= FLASH_PATTERN_MAX) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Invalid flash");
+		return;
+	}
+
+	flash_stop();
+
+	s_info.rect = rect;
+	s_info.pattern = &s_patterns[pattern];
+	s_info.started = cue_timeline_now();
+	s_info.alpha = -1;
+
+	cue_timeline_start(CUE_TRACK_FLASH, _advance, NULL);
+}
+
+/*
+ * @brief Stops the pattern that is playing and hides the rectangle.
+ */
+void flash_stop(void)
+{
+	if (s_info.pattern) {
+		cue_timeline_stop(CUE_TRACK_FLASH);
+		evas_object_hide(s_info.rect);
+		s_info.pattern = NULL;
+	}
+
+	s_info.rect = NULL;
+}
+
+/*
+ * @note Below functions are static functions.
+ */
+
+/*
+ * @brief Gets the alpha of a pattern at a time in its loop.
+ * @param[out] next_ms The elapsed time of the next change of the alpha, if it holds until then
+ */
+static int _evaluate(const struct flash_pattern_table *pattern, int elapsed_ms, int *next_ms)
+{
+	const struct flash_keyframe *from = NULL;
+	const struct flash_keyframe *to = NULL;
+	int time_ms = elapsed_ms % pattern->period_ms;
+	int span = 0;
+	int i = 0;
+
+	for (i = 1; i < pattern->num_keyframes && pattern->keyframes[i].time_ms <= time_ms; i++);
+
+	from = &pattern->keyframes[i - 1];
+	if (i == pattern->num_keyframes || from->step) {
+		*next_ms = elapsed_ms - time_ms + (i < pattern->num_keyframes ? pattern->keyframes[i].time_ms : pattern->period_ms);
+		return from->alpha;
+	}
+
+	*next_ms = -1;
+
+	/*
+	 * Fade in integer math, rounded to the nearest alpha.
+	 */
+	to = &pattern->keyframes[i];
+
+	span = to->time_ms - from->time_ms;
+
+	return (from->alpha * (span - (time_ms - from->time_ms)) + to->alpha * (time_ms - from->time_ms) + span / 2) / span;
+}
+
+/*
+ * @brief Shows the alpha of the pattern at now and returns the time of the next change.
+ */
+static double _advance(double now, void *data)
+{
+	int elapsed_ms = (int) ((now - s_info.started) * 1000.0 + 0.5);
+	int next_ms = 0;
+	int alpha = 0;
+
+	if (elapsed_ms >= s_info.pattern->duration_ms) {
+		evas_object_hide(s_info.rect);
+		s_info.pattern = NULL;
+		s_info.rect = NULL;
+		return -1.0;
+	}
+
+	alpha = _evaluate(s_info.pattern, elapsed_ms, &next_ms);
+	if (alpha != s_info.alpha) {
+		evas_object_color_set(s_info.rect, 255, 255, 255, alpha);
+		s_info.alpha = alpha;
+	}
+
+	if (next_ms < 0) {
+		return now + 1.0 / s_info.pattern->fps;
+	}
+
+	return s_info.started + (next_ms < s_info.pattern->duration_ms ? next_ms : s_info.pattern->duration_ms) / 1000.0;
+}
+
+/* End of file */
@@ -0,0 +1,538 @@
+/*
+ * history.c
+ *
+ * Append-only history of what happened to the reminders.
+ *
+ * The history file starts with a header of HISTORY_HEADER_LEN bytes, followed by the records:
+ *
+ *   varint   zigzag encoded seconds since the time of the previous record
+ *   byte     event in the low nibble, origin of the reminder in the high nibble
+ *   varint   response time in milliseconds
+ *
+ * Most records take 4 to 6 bytes. Records are appended to a buffer and written with a single write() and
+ * fdatasync() per batch, when history_flush() is called or the buffer is full. Each batch starts with
+ * a base record, event HISTORY_BASE_MARKER, that holds the time in seconds since the epoch. Batches do not
+ * depend on each other, so more than one process can append to the file. The file is read through
+ * a read-only mapping, so scanning years of history takes a few milliseconds.
+ * A record cut short by a power loss at the end of the file is dropped when the file is opened.
+ * A listener is told about every record appended and every flush, to keep rollups of the history up to date.
+ * Since every batch starts with a base record, the records another process appended can be read from the end
+ * of the last batch seen, without scanning the file again.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tizen_error.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "history.h"
+#include "alloc-debug.h"
+
+#define HISTORY_HEADER_LEN 4
+#define HISTORY_RECORD_MAX_LEN 16
+#define HISTORY_BUFFER_LEN 512
+#define HISTORY_BASE_MARKER 0x0f
+
+/*
+ * Counts the records passed to the callback of history_foreach().
+ */
+struct history_foreach_data {
+	history_record_cb cb;
+	void *data;
+	int count;
+};
+
+static const unsigned char s_header[HISTORY_HEADER_LEN] = { 'R', 'C', 'H', 1 };
+
+static struct history_info {
+	int fd;
+	off_t file_len;
+	int64_t last_time;
+	unsigned char buffer[HISTORY_BUFFER_LEN];
+	size_t buffered;
+	history_record_cb appended_cb;
+	history_flushed_cb flushed_cb;
+	void *listener_data;
+} s_info = {
+	.fd = -1,
+	.file_len = 0,
+	.last_time = 0,
+	.buffer = { 0, },
+	.buffered = 0,
+	.appended_cb = NULL,
+	.flushed_cb = NULL,
+	.listener_data = NULL,
+};
+
+static size_t _encode_varint(uint64_t value, unsigned char *out);
+static size_t _decode_varint(const unsigned char *in, size_t len, uint64_t *value);
+static size_t _decode_records(const unsigned char *in, size_t len, int64_t *last_time, history_record_cb cb, void *data, bool *stopped);
+static bool _validate_record_cb(const struct history_record *record, void *data);
+static bool _foreach_record_cb(const struct history_record *record, void *data);
+static int _write_all(const unsigned char *buf, size_t len, size_t *written);
+
+/*
+ * @brief Opens the history file, creating it if it does not exist.
+ * The file is scanned once, to drop a record cut short at its end.
+ * @param[in] path The path of the history file
+ * @return TIZEN_ERROR_NONE, or TIZEN_ERROR_IO_ERROR if the file can not be opened
+ */
+int history_initialize(const char *path)
+{
+	struct stat st;
+	unsigned char *map = NULL;
+	int64_t last_time = 0;
+	size_t valid = HISTORY_HEADER_LEN;
+	size_t written = 0;
+	bool stopped = false;
+
+	if (s_info.fd >= 0) {
+		return TIZEN_ERROR_NONE;
+	}
+
+	s_info.fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (s_info.fd < 0 || fstat(s_info.fd, &st) != 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to open the history %s: %s", path, strerror(errno));
+		history_finalize();
+		return TIZEN_ERROR_IO_ERROR;
+	}
+
+	if (st.st_size >= HISTORY_HEADER_LEN) {
+		map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, s_info.fd, 0);
+		if (map == MAP_FAILED) {
+			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to map the history: %s", strerror(errno));
+			history_finalize();
+			return TIZEN_ERROR_IO_ERROR;
+		}
+
+		if (memcmp(map, s_header, HISTORY_HEADER_LEN) == 0) {
+			valid += _decode_records(map + HISTORY_HEADER_LEN, (size_t) st.st_size - HISTORY_HEADER_LEN,
+					&last_time, _validate_record_cb, NULL, &stopped);
+		} else {
+			dlog_print(DLOG_ERROR, LOG_TAG, "The history has an unknown format, it is started again");
+			valid = 0;
+		}
+
+		munmap(map, (size_t) st.st_size);
+	} else {
+		valid = 0;
+	}
+
+	/*
+	 * Drop what follows the last complete record, so the next record is not appended to a partial one.
+	 */
+	if ((off_t) valid != st.st_size) {
+		if (ftruncate(s_info.fd, (off_t) valid) != 0) {
+			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to truncate the history: %s", strerror(errno));
+			history_finalize();
+			return TIZEN_ERROR_IO_ERROR;
+		}
+		dlog_print(DLOG_INFO, LOG_TAG, "History truncated from %lld to %zu bytes", (long long) st.st_size, valid);
+	}
+
+	if (valid == 0) {
+		if (_write_all(s_header, HISTORY_HEADER_LEN, &written) != TIZEN_ERROR_NONE) {
+			history_finalize();
+			return TIZEN_ERROR_IO_ERROR;
+		}
+		valid = HISTORY_HEADER_LEN;
+	}
+
+	s_info.file_len = (off_t) valid;
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Writes the buffered records and closes the history file.
+ */
+void history_finalize(void)
+{
+	if (s_info.fd < 0) {
+		return;
+	}
+
+	history_flush();
+
+	close(s_info.fd);
+	s_info.fd = -1;
+	s_info.buffered = 0;
+}
+
+/*
+ * @brief Appends a record to the history. The record is buffered, it is written by the next flush.
+ * The buffer is flushed first if it is full.
+ * @param[in] time The time of the event in seconds since the epoch
+ * @param[in] event What happened to the reminder
+ * @param[in] origin The origin of the reminder
+ * @param[in] response_ms The time from showing the reminder to the event in milliseconds, 0 if there was no response
+ * @return TIZEN_ERROR_NONE, TIZEN_ERROR_INVALID_PARAMETER, or the error of the flush
+ */
+int history_append(int64_t time, enum history_event event, enum schedule_origin origin, unsigned int response_ms)
+{
+	struct history_record record;
+	unsigned char *out = NULL;
+	int64_t delta = 0;
+	int ret = TIZEN_ERROR_NONE;
+
+	if (s_info.fd < 0 || event < 0 || event >= HISTORY_EVENT_MAX) {
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	if (s_info.buffered + 2 * HISTORY_RECORD_MAX_LEN > HISTORY_BUFFER_LEN) {
+		ret = history_flush();
+		if (ret != TIZEN_ERROR_NONE) {
+			return ret;
+		}
+	}
+
+	out = s_info.buffer + s_info.buffered;
+
+	/*
+	 * A batch starts with the time the records after it are encoded against.
+	 */
+	if (s_info.buffered == 0) {
+		out += _encode_varint(((uint64_t) time << 1) ^ (uint64_t) (time >> 63), out);
+		*out++ = HISTORY_BASE_MARKER;
+		*out++ = 0;
+		s_info.last_time = time;
+	}
+
+	/*
+	 * Zigzag encoding keeps the events recorded out of order, like caught up reminders, small.
+	 */
+	delta = time - s_info.last_time;
+	out += _encode_varint(((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63), out);
+	*out++ = (unsigned char) (event | (origin << 4));
+	out += _encode_varint(response_ms, out);
+
+	s_info.buffered = (size_t) (out - s_info.buffer);
+	s_info.last_time = time;
+
+	if (s_info.appended_cb) {
+		record.time = time;
+		record.event = event;
+		record.origin = origin;
+		record.response_ms = response_ms;
+		s_info.appended_cb(&record, s_info.listener_data);
+	}
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Writes the buffered records with a single write and makes them durable.
+ * @return TIZEN_ERROR_NONE, or TIZEN_ERROR_IO_ERROR if the records could not be written
+ */
+int history_flush(void)
+{
+	struct stat st;
+	size_t written = 0;
+	int ret = TIZEN_ERROR_NONE;
+
+	if (s_info.fd < 0 || s_info.buffered == 0) {
+		return TIZEN_ERROR_NONE;
+	}
+
+	/*
+	 * The other process may have appended to the file, the size is taken just before the write.
+	 */
+	if (fstat(s_info.fd, &st) != 0) {
+		return TIZEN_ERROR_IO_ERROR;
+	}
+
+	ret = _write_all(s_info.buffer, s_info.buffered, &written);
+	if (ret != TIZEN_ERROR_NONE) {
+		/*
+		 * The records are kept, the next flush tries again. A batch written in part is taken back,
+		 * so no record is written twice.
+		 */
+		if (written > 0 && ftruncate(s_info.fd, st.st_size) != 0) {
+			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to take back the history: %s", strerror(errno));
+		}
+		return ret;
+	}
+
+	if (fdatasync(s_info.fd) != 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to sync the history: %s", strerror(errno));
+	}
+
+	/*
+	 * The file ends after this batch, whatever the other process wrote before it.
+	 */
+	s_info.file_len = st.st_size + (off_t) written;
+	s_info.buffered = 0;
+
+	if (s_info.flushed_cb) {
+		s_info.flushed_cb((size_t) st.st_size, (size_t) s_info.file_len, s_info.listener_data);
+	}
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Calls the callback for each record of the history, the records that are not written yet included.
+ * @param[in] cb The callback
+ * @param[in] data Data passed to the callback
+ * @return The number of records passed to the callback, or a negative error
+ */
+int history_foreach(history_record_cb cb, void *data)
+{
+	struct history_foreach_data foreach_data = { cb, data, 0 };
+	struct stat st;
+	unsigned char *map = NULL;
+	int64_t last_time = 0;
+	bool stopped = false;
+
+	if (s_info.fd < 0 || cb == NULL) {
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	if (fstat(s_info.fd, &st) != 0) {
+		return TIZEN_ERROR_IO_ERROR;
+	}
+
+	if (st.st_size > HISTORY_HEADER_LEN) {
+		map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, s_info.fd, 0);
+		if (map == MAP_FAILED) {
+			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to map the history: %s", strerror(errno));
+			return TIZEN_ERROR_IO_ERROR;
+		}
+
+		madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+		_decode_records(map + HISTORY_HEADER_LEN, (size_t) st.st_size - HISTORY_HEADER_LEN,
+				&last_time, _foreach_record_cb, &foreach_data, &stopped);
+		munmap(map, (size_t) st.st_size);
+	}
+
+	if (!stopped) {
+		_decode_records(s_info.buffer, s_info.buffered, &last_time, _foreach_record_cb, &foreach_data, &stopped);
+	}
+
+	return foreach_data.count;
+}
+
+/*
+ * @brief Calls the callback for each record written to a range of the history file.
+ * The records that are not written yet are not included.
+ * @param[in] from The offset to read from. It has to be the end of the header or of a batch, like the size of the
+ * file at some point
+ * @param[in] to The offset to read up to, the end of the file if it is larger than the file
+ * @param[in] cb The callback
+ * @param[in] data Data passed to the callback
+ * @param[out] end The end of the last complete record read, the offset to read from the next time
+ * @return The number of records passed to the callback, or a negative error
+ */
+int history_foreach_range(size_t from, size_t to, history_record_cb cb, void *data, size_t *end)
+{
+	struct history_foreach_data foreach_data = { cb, data, 0 };
+	struct stat st;
+	unsigned char *map = NULL;
+	size_t map_offset = 0;
+	int64_t last_time = 0;
+	bool stopped = false;
+
+	if (s_info.fd < 0 || cb == NULL || end == NULL || from < HISTORY_HEADER_LEN) {
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	*end = from;
+
+	if (fstat(s_info.fd, &st) != 0) {
+		return TIZEN_ERROR_IO_ERROR;
+	}
+
+	if (to > (size_t) st.st_size) {
+		to = (size_t) st.st_size;
+	}
+
+	if (to <= from) {
+		return 0;
+	}
+
+	/*
+	 * A mapping starts at a page boundary.
+	 */
+	map_offset = from - from % (size_t) sysconf(_SC_PAGESIZE);
+	map = mmap(NULL, to - map_offset, PROT_READ, MAP_PRIVATE, s_info.fd, (off_t) map_offset);
+	if (map == MAP_FAILED) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to map the history: %s", strerror(errno));
+		return TIZEN_ERROR_IO_ERROR;
+	}
+
+	*end += _decode_records(map + (from - map_offset), to - from, &last_time, _foreach_record_cb, &foreach_data, &stopped);
+	munmap(map, to - map_offset);
+
+	return foreach_data.count;
+}
+
+/*
+ * @brief Gets the size of the history file, the records that are not written yet not included.
+ * @return The size in bytes, 0 if the history is not open
+ */
+size_t history_get_size(void)
+{
+	return s_info.fd < 0 ? 0 : (size_t) s_info.file_len;
+}
+
+/*
+ * @brief Sets the listener of the history. There is one listener, setting NULL callbacks removes it.
+ * @param[in] appended Called for each record appended, before it is written
+ * @param[in] flushed Called after the buffered records have been written
+ * @param[in] data Data passed to the callbacks
+ */
+void history_set_listener(history_record_cb appended, history_flushed_cb flushed, void *data)
+{
+	s_info.appended_cb = appended;
+	s_info.flushed_cb = flushed;
+	s_info.listener_data = data;
+}
+
+/*
+ * @note Below functions are static functions.
+ */
+
+/*
+ * @brief Encodes an unsigned LEB128 varint.
+ * @return The number of bytes written, at most 10
+ */
+static size_t _encode_varint(uint64_t value, unsigned char *out)
+{
+	size_t len = 0;
+
+	while (value >= 0x80) {
+		out[len++] = (unsigned char) (value | 0x80);
+		value >>= 7;
+	}
+	out[len++] = (unsigned char) value;
+
+	return len;
+}
+
+/*
+ * @brief Decodes an unsigned LEB128 varint.
+ * @return The number of bytes read, 0 if the varint is cut short or too long
+ */
+static size_t _decode_varint(const unsigned char *in, size_t len, uint64_t *value)
+{
+	uint64_t result = 0;
+	size_t i = 0;
+
+	for (i = 0; i < len && i < 10; i++) {
+		result |= (uint64_t) (in[i] & 0x7f) << (7 * i);
+		if ((in[i] & 0x80) == 0) {
+			*value = result;
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * @brief Decodes records and passes them to the callback.
+ * @param[in] in The encoded records
+ * @param[in] len The length of the encoded records
+ * @param[in,out] last_time The time the first record is encoded against, set to the time of the last record decoded.
+ * The base records are not passed to the callback, they only set the time.
+ * @param[in] cb The callback
+ * @param[in] data Data passed to the callback
+ * @param[out] stopped Set to true if the callback stopped the iteration
+ * @return The number of bytes of complete records
+ */
+static size_t _decode_records(const unsigned char *in, size_t len, int64_t *last_time, history_record_cb cb, void *data, bool *stopped)
+{
+	struct history_record record;
+	uint64_t zigzag = 0;
+	uint64_t response = 0;
+	size_t pos = 0;
+	size_t n = 0;
+	size_t m = 0;
+
+	while (pos < len) {
+		n = _decode_varint(in + pos, len - pos, &zigzag);
+		if (n == 0 || pos + n >= len) {
+			break;
+		}
+
+		m = _decode_varint(in + pos + n + 1, len - pos - n - 1, &response);
+		if (m == 0) {
+			break;
+		}
+
+		record.event = (enum history_event) (in[pos + n] & 0x0f);
+		record.origin = (enum schedule_origin) (in[pos + n] >> 4);
+		record.response_ms = (unsigned int) response;
+		record.time = (int64_t) ((zigzag >> 1) ^ -(zigzag & 1));
+		if (record.event != HISTORY_BASE_MARKER) {
+			record.time += *last_time;
+		}
+
+		pos += n + 1 + m;
+		*last_time = record.time;
+
+		if (record.event == HISTORY_BASE_MARKER) {
+			continue;
+		}
+
+		if (!cb(&record, data)) {
+			*stopped = true;
+			break;
+		}
+	}
+
+	return pos;
+}
+
+/*
+ * @brief Accepts every record, so the whole history is scanned.
+ */
+static bool _validate_record_cb(const struct history_record *record, void *data)
+{
+	return true;
+}
+
+/*
+ * @brief Passes a record to the callback of history_foreach() and counts it.
+ */
+static bool _foreach_record_cb(const struct history_record *record, void *data)
+{
+	struct history_foreach_data *foreach_data = data;
+
+	foreach_data->count++;
+
+	return foreach_data->cb(record, foreach_data->data);
+}
+
+/*
+ * @brief Writes the whole buffer to the history file, appending it.
+ * @param[out] written The number of bytes written, also when the write fails
+ */
+static int _write_all(const unsigned char *buf, size_t len, size_t *written)
+{
+	ssize_t ret = 0;
+
+	*written = 0;
+
+	while (*written < len) {
+		ret = write(s_info.fd, buf + *written, len - *written);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to write the history: %s", strerror(errno));
+			return TIZEN_ERROR_IO_ERROR;
+		}
+		*written += (size_t) ret;
+	}
+
+	return TIZEN_ERROR_NONE;
+}
+
+/* End of file */
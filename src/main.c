@@ -31,8 +31,24 @@
 #include "data.h"
 #include "view.h"
 #include "reality-check.h"
+#include "vibration.h"
+#include "flash.h"
+#include "timer-wheel.h"
+#include "alloc-debug.h"
+#include "cue.h"
+#include "payload.h"
+#include "schedule.h"
+#include "widget.h"
+#include "state.h"
+#include "operation.h"
+#include "history.h"
+#include "stats.h"
 
 #define INSTANCE_ID_FOR_APP_CONTROL "widget_instance_id_for_app_control"
+#define CATCH_UP_RING_SECONDS (60 * 60)
+#define RING_TIMEOUT_SECONDS 60.0
+#define HISTORY_FLUSH_SECONDS 10.0
+#define RING_BOOKKEEPING_SECONDS 0.5
 
 static struct main_info {
 	Elm_Object_Item *padding_item;
@@ -41,6 +57,8 @@ static struct main_info {
 	char *instance_id;
 	int port_id_for_widget;
 	Eina_Bool first_alarm;
+	Eina_Bool ui_created;
+	struct timer_wheel_entry history_flush;
 } s_info = {
 	.padding_item = NULL,
 	.widget_alarm = NULL,
@@ -48,20 +66,61 @@ static struct main_info {
 	.instance_id = NULL,
 	.port_id_for_widget = 0,
 	.first_alarm = EINA_FALSE,
+	.ui_created = EINA_FALSE,
+	.history_flush = { 0, },
 };
 
+/*
+ * Everything needed to ring an alarm, so ringing does not allocate.
+ * It is reset for every alarm, the path of the layout file is resolved once when the UI is created.
+ * Counting the delivery against the weekly quota and recording that the alarm was shown write preferences
+ * and the history buffer, they are left to the bookkeeping timer so they do not delay the first frame.
+ */
+static struct ring_context {
+	char edje_path[BUF_LEN];
+	char time_text[TIME_TEXT_LEN];
+	Evas_Object *layout;
+	struct timer_wheel_entry timeout;
+	struct timer_wheel_entry bookkeeping;
+	enum cue_pattern pattern;
+	enum schedule_origin origin;
+	double shown_at;
+	int64_t delivered_epoch;
+	int64_t shown_epoch;
+	Eina_Bool ringing;
+	unsigned int alloc_mark;
+} s_ring = {
+	.edje_path = { 0, },
+	.time_text = { 0, },
+	.layout = NULL,
+	.timeout = { 0, },
+	.bookkeeping = { 0, },
+	.pattern = CUE_PATTERN_ALARM,
+	.origin = SCHEDULE_ORIGIN_PLANNER,
+	.shown_at = 0.0,
+	.delivered_epoch = 0,
+	.shown_epoch = 0,
+	.ringing = EINA_FALSE,
+	.alloc_mark = 0,
+};
 
-static struct anim_data {
-	Evas_Object* rect;
-	int a;
-	int direction;
-	int count;
+/*
+ * The vibration and the flashing of each cue pattern.
+ */
+static const struct ring_cue {
+	enum vibration_pattern vibration;
+	enum flash_pattern flash;
+} s_ring_cues[CUE_PATTERN_MAX] = {
+	[CUE_PATTERN_ALARM] = { VIBRATION_PATTERN_ALARM, FLASH_PATTERN_PULSE },
+	[CUE_PATTERN_GENTLE] = { VIBRATION_PATTERN_GENTLE, FLASH_PATTERN_PULSE },
+	[CUE_PATTERN_AURORA] = { VIBRATION_PATTERN_HEARTBEAT, FLASH_PATTERN_AURORA },
 };
 
+
 static Evas_Object *_create_layout_no_alarmlist(Evas_Object *parent, const char *edje_path, const char *group_name);
 static void _set_layout_exist_alarmlist(Evas_Object *layout);
 static Evas_Object *_create_layout_set_time(Evas_Object *parent);
-static Evas_Object* _create_layout_ring_alarm(Evas_Object *parent, struct tm *saved_time);
+static Evas_Object* _create_layout_ring_alarm(Evas_Object *parent);
 static Eina_Bool _naviframe_pop_cb(void *data, Elm_Object_Item *it);
 static void _no_alarm_down_cb(void *data, Evas *e, Evas_Object *obj, void *event_info);
 static void _no_alarm_up_cb(void *data, Evas *e, Evas_Object *obj, void *event_info);
@@ -69,7 +128,27 @@ static void _no_alarm_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 static void _add_clicked_cb(void *data, Evas_Object *obj, void *event_info);
 static void _set_clicked_cb(void *data, Evas_Object *obj, void *event_info);
 static void _dismiss_clicked_cb(void *data, Evas_Object *obj, void *event_info);
+static void _ring_layout_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info);
+static void _ring_timeout_cb(void *data);
+#if defined(ALLOC_DEBUG)
+static void _ring_first_frame_cb(void *data, Evas *e, void *event_info);
+#endif
 static void _push_set_time_layout_to_naviframe(void);
+static void _alarm_on_off_changed_cb(struct genlist_item_data *gendata, Eina_Bool signal);
+static void _clock_changed_cb(system_settings_key_e key, void *user_data);
+static Eina_Bool _create_ui(void);
+static void _ring_context_reset(void);
+static void _ring_alarm(void);
+static void _ring_record(enum history_event event);
+static void _ring_bookkeeping_later(void);
+static void _ring_bookkeeping_cb(void *data);
+static void _history_flush_later(void);
+static void _history_flush_cb(void *data);
+static void _operation_alarm_ontime_cb(app_control_h app_control, void *user_data);
+static void _operation_main_cb(app_control_h app_control, void *user_data);
+static void _operation_widget_launch_cb(app_control_h app_control, void *user_data);
+static void _operation_widget_refresh_cb(app_control_h app_control, void *user_data);
+static void _operation_planner_wake_cb(app_control_h app_control, void *user_data);
 
 /*
  * @brief Destroys alarm widget by instance id.
@@ -78,8 +157,6 @@ static void _push_set_time_layout_to_naviframe(void);
 void alarm_destroy_widget(void *user_data)
 {
 	struct genlist_item_data *gendata = NULL;
-	bundle *b = NULL;
-	int ret = 0;
 
 	gendata = user_data;
 	if (gendata == NULL) {
@@ -87,32 +164,23 @@ void alarm_destroy_widget(void *user_data)
 		return;
 	}
 
-	b = data_get_widget_data_bundle();
-	if (b == NULL) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to get data bundle");
-		return;
-	}
-
-	bundle_del(b, "Operation");
-	bundle_add_str(b, "Operation", "Destroy");
-
-	ret = widget_service_trigger_update(gendata->widget_id, gendata->instance_id, b, 0);
-	if (ret != WIDGET_ERROR_NONE) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to (). ret = %d", ret);
-	}
+	/*
+	 * Every widget showing the alarm is told, then the alarm is not followed anymore.
+	 */
+	widget_registry_send_for_alarm(gendata->alarm_id, "Destroy", NULL, 0);
+	widget_registry_unsubscribe_alarm(gendata->alarm_id);
+	state_record_detach(gendata);
 }
 
 /*
- * @brief Destroys alarm widget by instance id.
+ * @brief Sets the state of the alarm shown by the widget.
  * @param[in] on_off The state of alarm(On/Off)
  * @param[in] user_data Data needed in this function
  */
 void alarm_set_widget_on_off(char *on_off, void *user_data)
 {
 	struct genlist_item_data *gendata = NULL;
-	bundle *b = NULL;
-	char alarm_id_str[BUF_LEN] = { 0, };
-	int ret = 0;
+	struct widget_value values[1];
 
 	gendata = user_data;
 	if (gendata == NULL) {
@@ -120,51 +188,88 @@ void alarm_set_widget_on_off(char *on_off, void *user_data)
 		return;
 	}
 
-	snprintf(alarm_id_str, sizeof(alarm_id_str), "%d", gendata->alarm_id);
+	dlog_print(DLOG_DEBUG, LOG_TAG, "%s[%d] widget_id(%s), instance_id(%s), alarm id(%d)",
+			__func__, __LINE__, gendata->widget_id, gendata->instance_id, gendata->alarm_id);
 
-	b = data_get_widget_data_bundle();
-	if (b == NULL) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "widget data bundle is NULL");
-		return;
-	}
+	/*
+	 * Every widget instance showing the alarm gets the change.
+	 * The update queue merges the changes and sends them once the main loop is idle.
+	 */
+	values[0].key = "OnOff";
+	values[0].value = !strcmp(on_off, "On") ? "On" : "Off";
+	widget_registry_send_for_alarm(gendata->alarm_id, "SetOnOff", values, 1);
 
-	bundle_del(b, "OnOff");
-	if (!strcmp(on_off, "On")) {
-		bundle_add_str(b, "OnOff", "On");
-	} else {
-		bundle_add_str(b, "OnOff", "Off");
-	}
+	state_record_set(gendata, !strcmp(on_off, "On"));
+}
 
-	bundle_del(b, "AlarmId");
-	bundle_add_str(b, "AlarmId", alarm_id_str);
+/*
+ * @brief Hooks to take necessary actions before main event loop starts.
+ * Initialize application's data. UI resources are created by the first operation that needs them.
+ * If this function returns true, the main loop of application starts
+ * If this function returns false, the application is terminated
+ */
+static bool app_create(void *user_data)
+{
+	char history_path[BUF_LEN] = { 0, };
+	char stats_path[BUF_LEN] = { 0, };
+	char *data_path = NULL;
 
-	bundle_del(b, "Operation");
-	bundle_add_str(b, "Operation", "SetOnOff");
+	dlog_print(DLOG_INFO, LOG_TAG, "App create");
+
+	data_initialize();
+
+	/*
+	 * Load the alarms that are already registered, the planner and the UI work on the schedule store.
+	 */
+	if (schedule_store_initialize() == TIZEN_ERROR_NONE) {
+		load_schedule();
+	}
 
-	dlog_print(DLOG_DEBUG, LOG_TAG, "%s[%d] widget_id(%s), instance_id(%s), alarm id(%s)",
-			__func__, __LINE__, gendata->widget_id, gendata->instance_id, alarm_id_str);
+	widget_registry_initialize();
+	state_record_initialize(_alarm_on_off_changed_cb);
 
-	widget_service_trigger_update(gendata->widget_id, gendata->instance_id, b, 0);
-	if (ret != WIDGET_ERROR_NONE) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to widget_service_trigger_update(). ret = %d", ret);
+	/*
+	 * Open the history of the reminders, it is kept in the data directory of the application.
+	 */
+	data_path = app_get_data_path();
+	if (data_path) {
+		snprintf(history_path, sizeof(history_path), "%s%s", data_path, HISTORY_FILE_NAME);
+		snprintf(stats_path, sizeof(stats_path), "%s%s", data_path, STATS_FILE_NAME);
+		free(data_path);
+		history_initialize(history_path);
+		stats_initialize(stats_path);
 	}
+
+	system_settings_set_changed_cb(SYSTEM_SETTINGS_KEY_LOCALE_TIMEZONE, _clock_changed_cb, NULL);
+	system_settings_set_changed_cb(SYSTEM_SETTINGS_KEY_TIME_CHANGED, _clock_changed_cb, NULL);
+
+	/*
+	 * Register the operations that app_control() handles.
+	 * The planner wake plans at every day boundary without the UI. Only the main launch checks the plan otherwise,
+	 * which starts the planning after the installation and costs a few preference reads afterwards.
+	 */
+	operation_register(APP_CONTROL_OPERATION_ALARM_ONTIME, OPERATION_NEED_UI, _operation_alarm_ontime_cb, NULL);
+	operation_register(APP_CONTROL_OPERATION_MAIN, OPERATION_NEED_PLANNER | OPERATION_NEED_UI, _operation_main_cb, NULL);
+	operation_register(APP_CONTROL_OPERATION_DEFAULT, OPERATION_NEED_UI, _operation_widget_launch_cb, NULL);
+	operation_register(APP_CONTROL_OPERATION_WIDGET_REFRESH, OPERATION_NEED_NONE, _operation_widget_refresh_cb, NULL);
+	operation_register(APP_CONTROL_OPERATION_PLANNER_WAKE, OPERATION_NEED_PLANNER, _operation_planner_wake_cb, NULL);
+
+	return true;
 }
 
 /*
- * @brief Hooks to take necessary actions before main event loop starts.
- * Initialize UI resources and application's data
- * If this function returns true, the main loop of application starts
- * If this function returns false, the application is terminated
+ * @brief Creates UI resources, if they are not created yet.
+ * @return EINA_TRUE if the UI is ready
  */
-static bool app_create(void *user_data)
+static Eina_Bool _create_ui(void)
 {
 	Evas_Object *layout = NULL;
 	Evas_Object *nf = NULL;
 	char edje_path[BUF_LEN] = { 0, };
 
-	dlog_print(DLOG_INFO, LOG_TAG, "App create");
-
-	data_initialize();
+	if (s_info.ui_created) {
+		return EINA_TRUE;
+	}
 
 	/*
 	 * Create base GUI.
@@ -180,13 +285,14 @@ static bool app_create(void *user_data)
 	 * Create a layout when there is no alarm list.
 	 */
 	data_get_resource_path("edje/main.edj", edje_path, sizeof(edje_path));
+	snprintf(s_ring.edje_path, sizeof(s_ring.edje_path), "%s", edje_path);
 
 	nf = view_get_naviframe();
 	layout = _create_layout_no_alarmlist(nf, edje_path, "base_alarm");
 	if (layout == NULL) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "failed to create a layout of no alarm.");
 		view_destroy();
-		return false;
+		return EINA_FALSE;
 	}
 
 	/*
@@ -208,71 +314,26 @@ static bool app_create(void *user_data)
 	 */
 	view_set_base_layout(layout);
 
-	return true;
-}
-
-
-static Eina_Bool on_next_frame1(void *data)
-{
-	struct anim_data* my_anim_data = (struct anim_data*) data;
-	const float tick_rate = 1.0 / 60.0;
-	// This is how long it should take for one cycle white -> transparent -> white
-	const float period = 0.4f;
-	const float range = 255.0f;
-	const float half_period = period * 0.5f;
-	const float rate_of_change = (tick_rate / half_period) * range;
-
-	my_anim_data->a += my_anim_data->direction * rate_of_change;
-	if (my_anim_data->a < 0)
-	{
-		my_anim_data->a = 0;
-		my_anim_data->direction = 1;
-		my_anim_data->count++;
-	} else if (my_anim_data->a > 255)
-	{
-		my_anim_data->a = 255;
-		my_anim_data->direction = -1;
-		my_anim_data->count++;
-	}
+	s_info.ui_created = EINA_TRUE;
 
-	evas_object_color_set(my_anim_data->rect, 255, 255, 255, my_anim_data->a);
-	if (my_anim_data->count < 5)
-	{
-		return ECORE_CALLBACK_RENEW;
-	} else
-	{
-		evas_object_hide(my_anim_data->rect);
-		evas_object_del(my_anim_data->rect);
-		free(my_anim_data);
-		return ECORE_CALLBACK_DONE;
-	}
+	return EINA_TRUE;
 }
 
 
-
 /*
  * @brief This callback function is called when another application
  * sends the launch request to the application
  */
 static void app_control(app_control_h app_control, void *user_data)
 {
+	const struct operation_entry *entry = NULL;
 	char *operation = NULL;
-	char *alarm_id = NULL;
-	Elm_Object_Item *item = NULL;
-	Evas_Object *genlist = NULL;
-	Evas_Object *nf = NULL;
-	struct genlist_item_data *gendata = NULL;
-	struct tm *saved_time = NULL;
-	int ret = 0;
+	int64_t now = 0;
+	int64_t latest = 0;
+	int missed = 0;
 
 	dlog_print(DLOG_INFO, LOG_TAG, "App control");
 
-
-	app_control_h app_control_2 = data_get_app_control();
-
-	// Try to update tomorrow's alarms
-	update_alarms(app_control_2);
-
 	/*
 	 * When it comes time to sound alarm that has set alarm_schedule_at_date(),
 	 * alarm API calls app_control(), with operation that has set by app_control_set_operation() in advance.
@@ -280,101 +341,314 @@ static void app_control(app_control_h app_control, void *user_data)
 	app_control_get_operation(app_control, &operation);
 	dlog_print(DLOG_INFO, LOG_TAG, "operation = %s", operation);
 
-	if (!strncmp(APP_CONTROL_OPERATION_ALARM_ONTIME, operation, strlen(APP_CONTROL_OPERATION_ALARM_ONTIME))) {
-		ret = app_control_get_extra_data(app_control, APP_CONTROL_DATA_ALARM_ID, &alarm_id);
-		if (ret != APP_CONTROL_ERROR_NONE) {
-			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to app_control_get_extra_data(). Can't get extra data.");
-			free(operation);
-			return;
-		}
+	entry = operation_find(operation);
+	if (entry == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "No handler for operation %s", operation);
+		free(operation);
+		return;
+	}
 
-		// We don't have extra data, just show the alarm window
-		//@@TODO: Remove the code that creates it
+	free(operation);
 
+	if (entry->needs & OPERATION_NEED_PLANNER) {
+		// Plan the days of the horizon that are not planned yet
+		update_alarms(data_get_app_control());
+	}
 
+	if ((entry->needs & OPERATION_NEED_UI) && !_create_ui()) {
+		ui_app_exit();
+		return;
+	}
 
-		// Turn on the screen
-		ret = device_power_wakeup(false);
-		if (ret != DEVICE_ERROR_NONE)
-		{
-			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to turn display on.");
-		}
-		ret = device_power_request_lock(POWER_LOCK_DISPLAY, 1000);
-		if (ret != DEVICE_ERROR_NONE)
-		{
-			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to lock the display on.");
+	/*
+	 * Reminders that were missed while the device was off are coalesced, so a long outage
+	 * does not end in a burst of ring screens. The handler skips the reminders marked missed here.
+	 */
+	if (entry->needs & OPERATION_NEED_UI) {
+		now = (int64_t) time(NULL);
+		missed = catch_up_missed(now, &latest);
+		if (missed > 0) {
+			_history_flush_later();
 		}
+	}
+
+	entry->handler(app_control, entry->user_data);
+
+	/*
+	 * Ring once for all missed reminders, unless a reminder rings already or the latest one is long gone.
+	 */
+	if (missed > 0 && !s_ring.ringing && now - latest < CATCH_UP_RING_SECONDS) {
+		_ring_context_reset();
+		snprintf(s_ring.time_text, sizeof(s_ring.time_text), "%d missed", missed);
+		_ring_alarm();
+	}
+
+	/*
+	 * Let the main screen and the widget know about the changes of the schedule.
+	 */
+	view_update_countdown();
+	widget_payload_push();
+
+	/*
+	 * Lightweight operations do not keep the application running without a window.
+	 */
+	if (!s_info.ui_created) {
+		ui_app_exit();
+	}
+}
+
+/*
+ * @brief Rings the alarm that has gone off.
+ * Nothing on the way to the first frame allocates, the alarm id and the payload are read in place from the bundle of the app_control.
+ * With the payload, the alarm is rendered and logged without a lookup. A reminder of the current plan generation
+ * rings without further checks, a reminder of an older one only if the current plan has kept it in the schedule store.
+ */
+static void _operation_alarm_ontime_cb(app_control_h app_control, void *user_data)
+{
+	bundle *b = NULL;
+	char *alarm_id = NULL;
+	Elm_Object_Item *item = NULL;
+	Evas_Object *genlist = NULL;
+	struct genlist_item_data *gendata = NULL;
+	struct alarm_payload payload;
+	struct tm date;
+	time_t epoch = 0;
+	unsigned int generation = 0;
+	bool has_payload = false;
+	int index = 0;
+	int id = 0;
+
+	_ring_context_reset();
+
+	if (app_control_to_bundle(app_control, &b) != APP_CONTROL_ERROR_NONE ||
+			bundle_get_str(b, APP_CONTROL_DATA_ALARM_ID, &alarm_id) != BUNDLE_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to get the alarm id. Can't get extra data.");
+		return;
+	}
+
+	id = atoi(alarm_id);
+	index = schedule_store_find(id);
 
+	has_payload = alarm_payload_read(app_control, &payload) == TIZEN_ERROR_NONE;
+	if (has_payload) {
 		/*
-		 * Create a layout when the alarm sounds.
+		 * Every replan starts a new generation. The reminders it keeps are in the store,
+		 * a reminder of an older plan that is not was not cancelled with it, it does not ring.
 		 */
-		saved_time = &gendata->saved_time;
-		nf = view_get_naviframe();
-		if (!nf)
-		{
+		generation = get_plan_generation();
+		if (payload.kind == SCHEDULE_ORIGIN_PLANNER && generation != 0 && payload.plan_generation != generation && index < 0) {
+			dlog_print(DLOG_INFO, LOG_TAG, "Alarm %d is of plan generation %u, the plan is %u. It does not ring",
+					id, payload.plan_generation, generation);
+			alarm_cancel(id);
 			return;
 		}
-		Evas_Object* layout_ring_alarm = _create_layout_ring_alarm(nf, saved_time);
-
-		// Vibrate to get user's attention
-		start_alarm_vibrate();
-
-		// Playing around with animations
-		// Get the rectangle for animation purposes
-		Evas_Object* layout_edje = elm_layout_edje_get(layout_ring_alarm);
-
-		const Evas_Object* rect = edje_object_part_object_get(layout_edje, "flashing.rect");
-		if (rect)
-		{
-			struct anim_data* my_anim_data = malloc(sizeof(struct anim_data));
-			my_anim_data->direction = -1;
-			my_anim_data->count = 0;
-			my_anim_data->rect = rect;
-			my_anim_data->a = 255;
-			ecore_animator_add(on_next_frame1, my_anim_data);
-			ecore_animator_frametime_set(1. / 60);
-		} else
-		{
-			dlog_print(DLOG_INFO, LOG_TAG, "Unable to find the rectangle");
+
+		epoch = (time_t) payload.epoch;
+		localtime_r(&epoch, &date);
+		if (strftime(s_ring.time_text, sizeof(s_ring.time_text), TIME_TEXT_FORMAT, &date) == 0) {
+			s_ring.time_text[0] = '\0';
+		}
+		if (payload.pattern >= 0 && payload.pattern < CUE_PATTERN_MAX) {
+			s_ring.pattern = payload.pattern;
 		}
+		s_ring.origin = payload.kind;
 
+		dlog_print(DLOG_INFO, LOG_TAG, "Alarm %d at%s, slot %d, origin %d, plan generation %u",
+				id, s_ring.time_text, payload.slot, payload.kind, payload.plan_generation);
+	}
 
-		/*
-		 * Remove widget and genlist's item that is consistent with alarm id.
-		 */
-		// alarm_destroy_widget(gendata);
-		// elm_object_item_del(item);
-
-	} else if (!strncmp(APP_CONTROL_OPERATION_MAIN, operation, strlen(APP_CONTROL_OPERATION_MAIN))) {
-		evas_object_show(view_get_window());
-	} else if (!strncmp(APP_CONTROL_OPERATION_DEFAULT, operation, strlen(APP_CONTROL_OPERATION_DEFAULT))) {
-		ret = app_control_get_app_id(app_control, &s_info.widget_id);
-		if (ret != APP_CONTROL_ERROR_NONE) {
-			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to get app id from appcontrol");
-			free(operation);
-			return;
-		}
+	/*
+	 * A reminder that was caught up on as missed, or that is delivered twice, does not ring again.
+	 */
+	if (index >= 0 && schedule_store_get_state(index) != SCHEDULE_STATE_PENDING) {
+		dlog_print(DLOG_INFO, LOG_TAG, "Alarm %d is not pending, it does not ring", id);
+		return;
+	}
+	/*
+	 * The payload knows who scheduled the alarm, the store is asked only for alarms without one.
+	 */
+	if (!has_payload && index >= 0) {
+		s_ring.origin = schedule_store_get_origin(index);
+	}
 
-		ret = app_control_get_extra_data(app_control, INSTANCE_ID_FOR_APP_CONTROL, &s_info.instance_id);
-		if (ret != APP_CONTROL_ERROR_NONE) {
-			dlog_print(DLOG_ERROR, LOG_TAG, "Failed to app_control_get_extra_data(). Can't get extra data.");
-			free(operation);
+	/*
+	 * A reminder of the planner counts against the weekly quota, once the first frame is out.
+	 */
+	if (s_ring.origin == SCHEDULE_ORIGIN_PLANNER) {
+		s_ring.delivered_epoch = (int64_t) time(NULL);
+		_ring_bookkeeping_later();
+	}
 
-			free(s_info.widget_id);
-			s_info.widget_id = NULL;
+	schedule_store_set_state(id, SCHEDULE_STATE_DELIVERED);
 
-			return;
+	/*
+	 * Alarms scheduled by older versions have no payload.
+	 * Find the alarm in the genlist to show its already formatted time.
+	 * Alarms scheduled by the planner are not part of the genlist.
+	 */
+	if (s_ring.time_text[0] == '\0') {
+		genlist = view_get_genlist();
+		item = view_alarm_find_item_from_genlist(genlist, id);
+		if (item) {
+			gendata = elm_object_item_data_get(item);
+			snprintf(s_ring.time_text, sizeof(s_ring.time_text), "%s", gendata->time_text);
 		}
+	}
 
-		dlog_print(DLOG_INFO, LOG_TAG, "%s[%d] widget_id(%s), instance_id(%s)",
-				__func__, __LINE__, s_info.widget_id, s_info.instance_id);
+	_ring_alarm();
 
-		data_initialize_widget_data();
+	/*
+	 * Remove widget and genlist's item that is consistent with alarm id.
+	 */
+	// alarm_destroy_widget(gendata);
+	// elm_object_item_del(item);
+}
+
+/*
+ * @brief Prepares the ring context for the next alarm. A layout that is still shown keeps ringing until it is replaced.
+ */
+static void _ring_context_reset(void)
+{
+	_ring_bookkeeping_cb(NULL);
+	timer_wheel_cancel(&s_ring.timeout);
+	s_ring.time_text[0] = '\0';
+	s_ring.pattern = CUE_PATTERN_ALARM;
+	s_ring.origin = SCHEDULE_ORIGIN_PLANNER;
+	s_ring.alloc_mark = ALLOC_DEBUG_MARK();
+}
 
-		_push_set_time_layout_to_naviframe();
+/*
+ * @brief Turns on the screen, shows the ring layout and starts the vibration and the flashing.
+ * The text of the ring context is shown on the layout, its cue pattern picks the vibration and the flashing.
+ */
+static void _ring_alarm(void)
+{
+	Evas_Object *nf = NULL;
+	int ret = 0;
+
+	// Turn on the screen
+	ret = device_power_wakeup(false);
+	if (ret != DEVICE_ERROR_NONE)
+	{
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to turn display on.");
+	}
+	ret = device_power_request_lock(POWER_LOCK_DISPLAY, 1000);
+	if (ret != DEVICE_ERROR_NONE)
+	{
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to lock the display on.");
 	}
 
-	free(operation);
+	/*
+	 * Create a layout when the alarm sounds.
+	 */
+	nf = view_get_naviframe();
+	if (!nf)
+	{
+		return;
+	}
+	Evas_Object* layout_ring_alarm = _create_layout_ring_alarm(nf);
+	if (!layout_ring_alarm)
+	{
+		return;
+	}
+	s_ring.layout = layout_ring_alarm;
+	s_ring.ringing = EINA_TRUE;
+	s_ring.shown_at = ecore_time_get();
+	timer_wheel_add(&s_ring.timeout, RING_TIMEOUT_SECONDS, TIMER_GROUP_RING, _ring_timeout_cb, NULL);
+	s_ring.shown_epoch = (int64_t) time(NULL);
+	_ring_bookkeeping_later();
+
+	// Vibrate to get user's attention
+	vibration_play(s_ring_cues[s_ring.pattern].vibration);
+
+	/*
+	 * Flash the rectangle of the ring layout. The flash only changes the color of the part object,
+	 * which edje returns as const.
+	 */
+	Evas_Object* layout_edje = elm_layout_edje_get(layout_ring_alarm);
+
+	Evas_Object* rect = (Evas_Object*) edje_object_part_object_get(layout_edje, "flashing.rect");
+	if (rect)
+	{
+		flash_play(rect, s_ring_cues[s_ring.pattern].flash);
+	} else
+	{
+		dlog_print(DLOG_INFO, LOG_TAG, "Unable to find the rectangle");
+	}
+
+#if defined(ALLOC_DEBUG)
+	evas_event_callback_add(evas_object_evas_get(layout_ring_alarm), EVAS_CALLBACK_RENDER_POST, _ring_first_frame_cb, NULL);
+#endif
+}
+
+#if defined(ALLOC_DEBUG)
+/*
+ * @brief Checks that the application code did not allocate from the receipt of the alarm to its first frame.
+ */
+static void _ring_first_frame_cb(void *data, Evas *e, void *event_info)
+{
+	evas_event_callback_del(e, EVAS_CALLBACK_RENDER_POST, _ring_first_frame_cb);
+
+	ALLOC_DEBUG_ASSERT_NONE_SINCE(s_ring.alloc_mark, "Ringing the alarm");
+}
+#endif
+
+/*
+ * @brief Shows the main screen.
+ */
+static void _operation_main_cb(app_control_h app_control, void *user_data)
+{
+	evas_object_show(view_get_window());
+}
+
+/*
+ * @brief Registers the widget instance that launched the application and lets the user set its alarm.
+ */
+static void _operation_widget_launch_cb(app_control_h app_control, void *user_data)
+{
+	int ret = 0;
+
+	ret = app_control_get_app_id(app_control, &s_info.widget_id);
+	if (ret != APP_CONTROL_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to get app id from appcontrol");
+		return;
+	}
+
+	ret = app_control_get_extra_data(app_control, INSTANCE_ID_FOR_APP_CONTROL, &s_info.instance_id);
+	if (ret != APP_CONTROL_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to app_control_get_extra_data(). Can't get extra data.");
+
+		free(s_info.widget_id);
+		s_info.widget_id = NULL;
+
+		return;
+	}
+
+	dlog_print(DLOG_INFO, LOG_TAG, "%s[%d] widget_id(%s), instance_id(%s)",
+			__func__, __LINE__, s_info.widget_id, s_info.instance_id);
+
+	widget_registry_add(s_info.widget_id, s_info.instance_id);
+
+	_push_set_time_layout_to_naviframe();
+}
+
+/*
+ * @brief Sends the payload to the widgets again, without touching the view.
+ */
+static void _operation_widget_refresh_cb(app_control_h app_control, void *user_data)
+{
+	widget_payload_invalidate();
+}
+
+/*
+ * @brief Handles the alarm at the start of a day, the day has been planned before. The UI is not created.
+ * The reminders that went by while the device was off are recorded as missed, so they do not ring later.
+ */
+static void _operation_planner_wake_cb(app_control_h app_control, void *user_data)
+{
+	if (catch_up_missed((int64_t) time(NULL), NULL) > 0) {
+		_history_flush_later();
+	}
 }
 
 /*
@@ -391,6 +665,17 @@ static void app_pause(void *user_data)
 	/* Take necessary actions when application becomes invisible. */
 	dlog_print(DLOG_INFO, LOG_TAG, "App pause");
 
+	/*
+	 * The application may not come back, write the history now.
+	 */
+	_ring_bookkeeping_cb(NULL);
+	timer_wheel_cancel(&s_info.history_flush);
+	history_flush();
+
+	if (!s_info.ui_created) {
+		return;
+	}
+
 	nf = view_get_naviframe();
 
 	top_item = elm_naviframe_top_item_get(nf);
@@ -413,6 +698,10 @@ static void app_resume(void *user_data)
 	/* Take necessary actions when application becomes visible. */
 	dlog_print(DLOG_INFO, LOG_TAG, "App resume");
 
+	if (!s_info.ui_created) {
+		return;
+	}
+
 	evas_object_show(view_get_window());
 }
 
@@ -426,16 +715,39 @@ static void app_terminate(void *user_data)
 	 */
 	dlog_print(DLOG_INFO, LOG_TAG, "App terminate");
 
-	if (ALARM_ERROR_NONE != alarm_cancel_all()) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to cancel all scheduled alarms.");
+	/*
+	 * The scheduled reminders stay registered, the planner keeps them up to date.
+	 */
+	system_settings_unset_changed_cb(SYSTEM_SETTINGS_KEY_LOCALE_TIMEZONE);
+	system_settings_unset_changed_cb(SYSTEM_SETTINGS_KEY_TIME_CHANGED);
+	if (s_info.ui_created) {
+		view_alarm_destroy();
 	}
 
-	view_alarm_destroy();
+	/*
+	 * The main loop does not become idle anymore, send the queued widget updates now.
+	 */
+	widget_queue_flush();
+	widget_registry_finalize();
+	state_record_finalize();
+	flash_stop();
+	vibration_finalize();
 
-	data_widget_data_finalize();
 	data_finalize();
+	schedule_store_finalize();
+	operation_unregister_all();
+
+	if (s_info.ui_created) {
+		view_destroy();
+		s_info.ui_created = EINA_FALSE;
+	}
+
+	_ring_bookkeeping_cb(NULL);
+	timer_wheel_cancel(&s_info.history_flush);
+	history_finalize();
+	stats_finalize();
 
-	view_destroy();
+	timer_wheel_finalize();
 }
 
 /*
@@ -452,9 +764,34 @@ static void ui_app_lang_changed(app_event_info_h event_info, void *user_data)
 		elm_language_set(locale);
 		free(locale);
 	}
+
+	/*
+	 * The time texts of the alarms are cached, so they have to be formatted again.
+	 */
+	view_alarm_update_time_texts();
 	return;
 }
 
+/*
+ * @brief This function will be called when the time or the time zone is changed.
+ * @param[in] key The key of the changed setting
+ * @param[in] user_data The user data passed to system_settings_set_changed_cb()
+ */
+static void _clock_changed_cb(system_settings_key_e key, void *user_data)
+{
+	int count = 0;
+
+	count = handle_clock_change(data_get_app_control());
+	dlog_print(DLOG_INFO, LOG_TAG, "Clock changed(%d), %d reminders registered again.", key, count);
+
+	/*
+	 * The local days have moved, so the widget gets a new payload even if no reminder was touched.
+	 */
+	view_update_countdown();
+	widget_payload_invalidate();
+	widget_payload_push();
+}
+
 /*
  * @brief Main function of the application.
  */
@@ -509,6 +846,8 @@ static Evas_Object *_create_layout_no_alarmlist(Evas_Object *parent, const char
 		return NULL;
 	}
 
+	view_create_settings_box(layout);
+
 	// view_set_text(layout, "no_alarm.title", "Alarm");
 
 	// view_set_button(layout, "swallow.no_alarm.button", "focus", NULL, NULL, _no_alarm_down_cb, _no_alarm_up_cb, _no_alarm_clicked_cb, layout);
@@ -606,13 +945,10 @@ static Evas_Object *_create_layout_set_time(Evas_Object *parent)
 /*
  * @brief Creates layout for a page that shows when the alarm sounds.
  * @param[in] parent The object to which you want to add this layout
- * @param[in] saved_time Time that sound the alarm
  */
-static Evas_Object* _create_layout_ring_alarm(Evas_Object *parent, struct tm *saved_time)
+static Evas_Object* _create_layout_ring_alarm(Evas_Object *parent)
 {
 	Evas_Object *layout = NULL;
-	char buf[BUF_LEN] = {0, };
-	char file_path[BUF_LEN] = {0, };
 
 	if (parent == NULL) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "failed to get parent.");
@@ -622,17 +958,14 @@ static Evas_Object* _create_layout_ring_alarm(Evas_Object *parent, struct tm *sa
 	/*
 	 * Create a layout that shows when the alarm sounds.
 	 */
-	data_get_resource_path("edje/main.edj", file_path, sizeof(file_path));
-
-	layout = view_create_layout(parent, file_path, "ringing_alarm", NULL, NULL);
+	layout = view_create_layout(parent, s_ring.edje_path, "ringing_alarm", NULL, NULL);
 	if (layout == NULL) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "failed to create a layout.");
 		return NULL;
 	}
 
-	if (saved_time) {
-		strftime(buf, sizeof(buf) - 1, "%l:%M %p", saved_time);
-		view_set_text(layout, "ringing_alarm.text", buf);
+	if (s_ring.time_text[0]) {
+		view_set_text(layout, "ringing_alarm.text", s_ring.time_text);
 	}
 
 	Evas_Object* test = elm_layout_edje_get(layout);
@@ -652,68 +985,142 @@ static Evas_Object* _create_layout_ring_alarm(Evas_Object *parent, struct tm *sa
 
 	view_push_item_to_naviframe(parent, layout, NULL, NULL);
 
+	/*
+	 * However the layout is popped, the alarm stops with it.
+	 */
+	evas_object_event_callback_add(layout, EVAS_CALLBACK_DEL, _ring_layout_del_cb, NULL);
+
 	return layout;
 }
 
 /*
- * @brief This function will be operated when preference value is changed.
- * @param[in] key The name of the key to monitor
- * @param[in] user_data The user data to be passed to the callback function
+ * @brief Stops the cues and cancels the timers of the alarm when the ring layout is deleted.
  */
-static void _alarm_on_off_changed_cb(const char *key, void *user_data)
+static void _ring_layout_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info)
+{
+	/*
+	 * A layout that was replaced by the layout of a newer alarm has nothing to stop.
+	 */
+	if (obj != s_ring.layout) {
+		return;
+	}
+
+	timer_wheel_cancel_group(TIMER_GROUP_RING);
+	vibration_stop();
+	flash_stop();
+	s_ring.layout = NULL;
+	s_ring.ringing = EINA_FALSE;
+}
+
+/*
+ * @brief Takes down an alarm that has been ignored. It does not count as doing the reality check.
+ */
+static void _ring_timeout_cb(void *data)
+{
+	dlog_print(DLOG_INFO, LOG_TAG, "The alarm was ignored");
+
+	_ring_record(HISTORY_EVENT_IGNORED);
+
+	elm_naviframe_item_pop(view_get_naviframe());
+}
+
+/*
+ * @brief Records the response to the ringing alarm in the history, with the time since it was shown.
+ * The bookkeeping of the ring is done first, so the alarm is recorded as shown before the response.
+ * Only the buffer of the history is written, the file is written a little later.
+ * @param[in] event What happened to the alarm
+ */
+static void _ring_record(enum history_event event)
+{
+	unsigned int response_ms = (unsigned int) ((ecore_time_get() - s_ring.shown_at) * 1000.0 + 0.5);
+
+	_ring_bookkeeping_cb(NULL);
+
+	history_append((int64_t) time(NULL), event, s_ring.origin, response_ms);
+	_history_flush_later();
+}
+
+/*
+ * @brief Does the bookkeeping of the ring after RING_BOOKKEEPING_SECONDS, when the first frame has been shown.
+ */
+static void _ring_bookkeeping_later(void)
+{
+	if (!timer_wheel_pending(&s_ring.bookkeeping)) {
+		timer_wheel_add(&s_ring.bookkeeping, RING_BOOKKEEPING_SECONDS, TIMER_GROUP_NONE, _ring_bookkeeping_cb, NULL);
+	}
+}
+
+/*
+ * @brief Counts the delivery against the weekly quota and records that the alarm was shown, if that is still to do.
+ * It is also called directly whenever the bookkeeping has to be done before something else.
+ */
+static void _ring_bookkeeping_cb(void *data)
+{
+	timer_wheel_cancel(&s_ring.bookkeeping);
+
+	if (s_ring.delivered_epoch) {
+		note_reminder_delivered(s_ring.delivered_epoch);
+		s_ring.delivered_epoch = 0;
+	}
+
+	if (s_ring.shown_epoch) {
+		history_append(s_ring.shown_epoch, HISTORY_EVENT_SHOWN, s_ring.origin, 0);
+		s_ring.shown_epoch = 0;
+		_history_flush_later();
+	}
+}
+
+/*
+ * @brief Writes the history after HISTORY_FLUSH_SECONDS, so the records of a few events are written together.
+ */
+static void _history_flush_later(void)
+{
+	if (!timer_wheel_pending(&s_info.history_flush)) {
+		timer_wheel_add(&s_info.history_flush, HISTORY_FLUSH_SECONDS, TIMER_GROUP_NONE, _history_flush_cb, NULL);
+	}
+}
+
+/*
+ * @brief Writes the buffered records of the history.
+ */
+static void _history_flush_cb(void *data)
+{
+	history_flush();
+}
+
+/*
+ * @brief This function will be operated when the widget changes the state of an alarm.
+ * @param[in] gendata The alarm whose state has changed
+ * @param[in] signal The new state of the alarm
+ */
+static void _alarm_on_off_changed_cb(struct genlist_item_data *gendata, Eina_Bool signal)
 {
-	struct genlist_item_data *gendata;
-	char *on_off = NULL;
-	int ret = 0;
 	Eina_Bool check_state = EINA_FALSE;
-	Eina_Bool signal = EINA_FALSE;
 	Elm_Object_Item *item = NULL;
 
-	gendata = user_data;
 	if (gendata == NULL) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to get gendata");
 		return;
 	}
 
 	check_state = gendata->check_state;
-	if (check_state == EINA_FALSE) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "check_state is strange");
-	}
 
 	item = gendata->item;
 	if (item == NULL) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "item is strange");
 	}
 
-	ret = preference_get_string(key, &on_off);
-	if (ret != PREFERENCE_ERROR_NONE) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to get preference value : on/off");
-		return;
-	}
-
-	if (!strcmp(on_off, "On")) {
-		dlog_print(DLOG_INFO, LOG_TAG, "signal is On");
-		signal = EINA_TRUE;
-	} else {
-		dlog_print(DLOG_INFO, LOG_TAG, "signal is Off");
-		signal = EINA_FALSE;
-	}
-
-	free(on_off);
+	dlog_print(DLOG_INFO, LOG_TAG, "signal is %s", signal ? "On" : "Off");
 
 	if (signal == check_state) {
 		dlog_print(DLOG_INFO, LOG_TAG, "Signal is from itself, DO NOT ANYTHING");
 	} else {
-		struct tm *saved_time = NULL;
 		int alarm_id = 0;
 		char buf[BUF_LEN] = {0, };
 
-		saved_time = &gendata->saved_time;
 		alarm_id = gendata->alarm_id;
 
 		if (signal == EINA_TRUE) {
-			app_control_h app_control;
-
 			/*
 			 * Store the current state of check box in gendata.
 			 */
@@ -723,13 +1130,16 @@ static void _alarm_on_off_changed_cb(const char *key, void *user_data)
 			 * Reset alarm using time that user sets before.
 			 * But, alarm ID is new.
 			 */
-			app_control = data_get_app_control();
-			alarm_schedule_at_date(app_control, saved_time, 0, &alarm_id);
+			data_schedule_alarm(gendata, &alarm_id);
 
 			/*
-			 * Store the new alarm ID in gendata.
+			 * Store the new alarm ID in gendata and in the schedule store.
+			 * The widgets showing the alarm follow it to the new ID.
 			 */
+			widget_registry_move_alarm(gendata->alarm_id, alarm_id);
 			gendata->alarm_id = alarm_id;
+			state_record_set(gendata, EINA_TRUE);
+			schedule_store_add(data_get_saved_epoch(gendata), alarm_id, SCHEDULE_STATE_PENDING, SCHEDULE_ORIGIN_USER);
 
 			/*
 			 * Add bundle using specific alarm ID as key.
@@ -746,6 +1156,7 @@ static void _alarm_on_off_changed_cb(const char *key, void *user_data)
 			 * Cancels the alarm with the specific alarm ID.
 			 */
 			alarm_cancel(alarm_id);
+			schedule_store_remove(alarm_id);
 
 			/*
 			 * Remove bundle using specific alarm ID as key.
@@ -754,6 +1165,7 @@ static void _alarm_on_off_changed_cb(const char *key, void *user_data)
 			data_delete_bundle(buf);
 		}
 		elm_genlist_item_update(item);
+		widget_payload_push();
 	}
 }
 
@@ -764,52 +1176,34 @@ static void _alarm_on_off_changed_cb(const char *key, void *user_data)
 static void _alarm_set_time_for_widget(void *user_data)
 {
 	struct genlist_item_data *gendata = user_data;
-	struct tm *saved_time = NULL;
-	char alarm_time[BUF_LEN] = { 0, };
-	char alarm_id_str[BUF_LEN] = { 0, };
-	int ret = 0;
-
+	char slot_str[BUF_LEN] = { 0, };
+	struct widget_value values[3];
 
 	if (gendata == NULL) {
 		dlog_print(DLOG_ERROR, LOG_TAG, "gendata is NULL");
 		return;
 	}
 
-	/*
-	 * Let the widget knows what the time is for alarm.
-	 */
-	saved_time = &gendata->saved_time;
-	if (saved_time->tm_hour > 12) {
-		snprintf(alarm_time, sizeof(alarm_time), "%02d:%02d PM", saved_time->tm_hour, saved_time->tm_min);
-	} else {
-		snprintf(alarm_time, sizeof(alarm_time), "%02d:%02d AM", saved_time->tm_hour, saved_time->tm_min);
-	}
-
-	snprintf(alarm_id_str, sizeof(alarm_id_str), "%d", gendata->alarm_id);
-
-	data_add_widget_data_bundle_by_str("Operation", "SetAlarm");
-	data_add_widget_data_bundle_by_str("AlarmTime", alarm_time);
-	data_add_widget_data_bundle_by_str("OnOff", "On");
-	data_add_widget_data_bundle_by_str("AlarmId", alarm_id_str);
-
-	gendata->widget_id = strdup(s_info.widget_id);
-	gendata->instance_id = strdup(s_info.instance_id);
+	data_set_id_to_gendata(gendata, s_info.widget_id, s_info.instance_id);
 	dlog_print(DLOG_DEBUG, LOG_TAG, "%s[%d] widget_id(%s), instance id(%s)", __func__, __LINE__, s_info.widget_id, s_info.instance_id);
 
-	ret = widget_service_trigger_update(gendata->widget_id, gendata->instance_id, data_get_widget_data_bundle(), 0);
-	if (ret != WIDGET_ERROR_NONE) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to widget_service_trigger_update(). ret = %d", ret);
-	}
-
-	ret = preference_set_string(alarm_id_str, "On");
-	if (ret != PREFERENCE_ERROR_NONE) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to set preference string : %s", alarm_id_str);
-	}
+	/*
+	 * The widget toggles the alarm through its slot in the shared state record.
+	 */
+	snprintf(slot_str, sizeof(slot_str), "%d", state_record_attach(gendata, EINA_TRUE));
 
-	ret = preference_set_changed_cb(alarm_id_str, _alarm_on_off_changed_cb, gendata);
-	if (ret != PREFERENCE_ERROR_NONE) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to set changed cb(%d) : on/off", ret);
-	}
+	/*
+	 * Let the widget knows what the time is for alarm.
+	 * The instance that asked for the alarm follows its changes from now on.
+	 */
+	widget_registry_subscribe(s_info.instance_id, gendata->alarm_id);
+	values[0].key = "AlarmTime";
+	values[0].value = gendata->time_text;
+	values[1].key = "OnOff";
+	values[1].value = "On";
+	values[2].key = "Slot";
+	values[2].value = slot_str;
+	widget_registry_send_for_alarm(gendata->alarm_id, "SetAlarm", values, 3);
 
 	free(s_info.instance_id);
 	free(s_info.widget_id);
@@ -913,7 +1307,7 @@ static void _set_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 	Evas_Object *layout = NULL;
 	Evas_Object *genlist = NULL;
 	Evas_Object *nf = NULL;
-	char *popup_text = NULL;
+	char popup_text[BUF_LEN] = {0, };
 	char buf[BUF_LEN] = {0, };
 
 	/*
@@ -950,11 +1344,8 @@ static void _set_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 	 * Create popup that shows how much time left before the alarm rings.
 	 */
 	layout = view_get_base_layout();
-	popup_text = data_get_popup_text(&gendata->saved_time);
+	data_get_popup_text(&gendata->saved_time, popup_text, sizeof(popup_text));
 	view_create_text_popup(layout, 2.0, popup_text);
-	if (popup_text) {
-		free(popup_text);
-	}
 
 	/*
 	 * Append the alarm to genlist as a item.
@@ -983,6 +1374,8 @@ static void _set_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 	} else {
 		data_initialize_widget_id_in_gendata(gendata);
 	}
+
+	widget_payload_push();
 }
 
 /*
@@ -1011,6 +1404,15 @@ static void _dismiss_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 		view_send_signal_to_edje(layout, "genlist.hide", "alarm");
 	}
 
+	/*
+	 * Dismissing the alarm counts as doing the reality check.
+	 * The cues and the timers of the alarm stop when the layout is deleted.
+	 */
+	mark_reality_check_done((int64_t) time(NULL));
+	_ring_record(HISTORY_EVENT_DISMISSED);
+	widget_payload_invalidate();
+	widget_payload_push();
+
 	nf = view_get_naviframe();
 	elm_naviframe_item_pop(nf);
 }
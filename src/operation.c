@@ -0,0 +1,135 @@
+/*
+ * operation.c
+ *
+ * Dispatch table of the app_control operations.
+ *
+ * The handlers are registered with the hash of their operation, computed once.
+ * An incoming operation is hashed once and found with a probe or two
+ * in a small open addressing table, then compared with the stored string.
+ */
+
+#include <string.h>
+#include <tizen_error.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "operation.h"
+
+/*
+ * Must be a power of two.
+ */
+#define OPERATION_TABLE_SIZE 16
+
+static struct operation_info {
+	struct operation_entry entries[OPERATION_TABLE_SIZE];
+	int count;
+} s_info = {
+	.entries = { { NULL, }, },
+	.count = 0,
+};
+
+/*
+ * @brief Registers a handler for an operation.
+ * @param[in] operation The operation, it must stay valid while registered
+ * @param[in] needs The operation_need flags of the handler
+ * @param[in] handler The handler
+ * @param[in] user_data The data passed to the handler
+ */
+int operation_register(const char *operation, int needs, operation_handler_cb handler, void *user_data)
+{
+	struct operation_entry *entry = NULL;
+	uint32_t hash = 0;
+	int i;
+
+	if (operation == NULL || handler == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] invalid parameter", __func__, __LINE__);
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	/*
+	 * One slot stays empty, so a lookup of an unknown operation always ends.
+	 */
+	if (s_info.count == OPERATION_TABLE_SIZE - 1) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Too many operations, %s is not registered.", operation);
+		return TIZEN_ERROR_OUT_OF_MEMORY;
+	}
+
+	hash = operation_hash(operation);
+
+	for (i = hash & (OPERATION_TABLE_SIZE - 1); ; i = (i + 1) & (OPERATION_TABLE_SIZE - 1)) {
+		entry = &s_info.entries[i];
+		if (entry->operation == NULL) {
+			s_info.count++;
+			break;
+		}
+
+		if (entry->hash == hash && !strcmp(entry->operation, operation)) {
+			dlog_print(DLOG_INFO, LOG_TAG, "Handler of %s is replaced.", operation);
+			break;
+		}
+	}
+
+	entry->operation = operation;
+	entry->hash = hash;
+	entry->needs = needs;
+	entry->handler = handler;
+	entry->user_data = user_data;
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Finds the handler of an operation.
+ * @param[in] operation The operation
+ * @return The entry of the operation, or NULL if no handler is registered
+ */
+const struct operation_entry *operation_find(const char *operation)
+{
+	struct operation_entry *entry = NULL;
+	uint32_t hash = 0;
+	int i;
+
+	if (operation == NULL) {
+		return NULL;
+	}
+
+	hash = operation_hash(operation);
+
+	for (i = hash & (OPERATION_TABLE_SIZE - 1); ; i = (i + 1) & (OPERATION_TABLE_SIZE - 1)) {
+		entry = &s_info.entries[i];
+		if (entry->operation == NULL) {
+			return NULL;
+		}
+
+		if (entry->hash == hash && !strcmp(entry->operation, operation)) {
+			return entry;
+		}
+	}
+}
+
+/*
+ * @brief Removes all handlers.
+ */
+void operation_unregister_all(void)
+{
+	memset(s_info.entries, 0, sizeof(s_info.entries));
+	s_info.count = 0;
+}
+
+/*
+ * @brief Hashes an operation (32-bit FNV-1a).
+ * @param[in] operation The operation
+ */
+uint32_t operation_hash(const char *operation)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*operation) {
+		hash ^= (unsigned char) *operation++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* End of file */
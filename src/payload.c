@@ -0,0 +1,122 @@
+/*
+ * payload.c
+ *
+ * Payload that every scheduled reminder carries in the extra data of its app_control.
+ *
+ * The payload is encoded as dot separated hexadecimal fields behind a version:
+ *
+ *   1.<slot + 1>.<epoch>.<plan generation>.<pattern>.<kind>
+ *
+ * The slot is stored plus one, so a reminder without a slot (-1) encodes as 0.
+ * Decoding does not allocate, it reads the string in place from the bundle of the app_control.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <tizen_error.h>
+#include <app_alarm.h>
+#include <app_control.h>
+#include <bundle.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "payload.h"
+#include "alloc-debug.h"
+
+#define ALARM_PAYLOAD_VERSION 1
+
+/*
+ * @brief Encodes a payload.
+ * @param[in] payload The payload
+ * @param[out] buf The buffer for the encoded payload, ALARM_PAYLOAD_LEN is always enough
+ * @param[in] buf_len Size of the buffer
+ * @return TIZEN_ERROR_NONE, or TIZEN_ERROR_INVALID_PARAMETER if the buffer is too small
+ */
+int alarm_payload_encode(const struct alarm_payload *payload, char *buf, int buf_len)
+{
+	int len = snprintf(buf, buf_len, "%x.%x.%" PRIx64 ".%x.%x.%x", ALARM_PAYLOAD_VERSION,
+			(unsigned int) (payload->slot + 1), (uint64_t) payload->epoch, payload->plan_generation,
+			(unsigned int) payload->pattern, (unsigned int) payload->kind);
+
+	return len > 0 && len < buf_len ? TIZEN_ERROR_NONE : TIZEN_ERROR_INVALID_PARAMETER;
+}
+
+/*
+ * @brief Decodes a payload.
+ * @param[in] text The encoded payload
+ * @param[out] payload The payload
+ * @return TIZEN_ERROR_NONE, or TIZEN_ERROR_INVALID_PARAMETER if the text is not a payload of this version
+ */
+int alarm_payload_decode(const char *text, struct alarm_payload *payload)
+{
+	unsigned int version = 0;
+	unsigned int slot = 0;
+	uint64_t epoch = 0;
+	unsigned int pattern = 0;
+	unsigned int kind = 0;
+
+	if (text == NULL ||
+			sscanf(text, "%x.%x.%" SCNx64 ".%x.%x.%x", &version, &slot, &epoch, &payload->plan_generation, &pattern, &kind) != 6 ||
+			version != ALARM_PAYLOAD_VERSION || kind > SCHEDULE_ORIGIN_USER) {
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	payload->slot = (int) slot - 1;
+	payload->epoch = (int64_t) epoch;
+	payload->pattern = (int) pattern;
+	payload->kind = (enum schedule_origin) kind;
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Schedules a reminder that carries a payload.
+ * The app_control is cloned, so the operation and the application ID set on it are kept for every reminder.
+ * @param[in] app_control The app_control the reminder launches
+ * @param[in] payload The payload of the reminder
+ * @param[in] date The time of the reminder
+ * @param[out] alarm_id The ID of the scheduled alarm
+ * @return ALARM_ERROR_NONE, or the error of the alarm API
+ */
+int alarm_payload_schedule(app_control_h app_control, const struct alarm_payload *payload, struct tm *date, int *alarm_id)
+{
+	app_control_h reminder_control = NULL;
+	char buf[ALARM_PAYLOAD_LEN] = { 0, };
+	int ret = 0;
+
+	if (app_control_clone(&reminder_control, app_control) != APP_CONTROL_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to clone the app_control of a reminder.");
+		return alarm_schedule_at_date(app_control, date, 0, alarm_id);
+	}
+
+	if (alarm_payload_encode(payload, buf, sizeof(buf)) == TIZEN_ERROR_NONE) {
+		app_control_add_extra_data(reminder_control, APP_CONTROL_DATA_ALARM_PAYLOAD, buf);
+	}
+
+	ret = alarm_schedule_at_date(reminder_control, date, 0, alarm_id);
+
+	app_control_destroy(reminder_control);
+
+	return ret;
+}
+
+/*
+ * @brief Reads the payload of the reminder that launched the application.
+ * @param[in] app_control The app_control the reminder launched the application with
+ * @param[out] payload The payload
+ * @return TIZEN_ERROR_NONE, or TIZEN_ERROR_NO_DATA if the reminder has no payload, like reminders scheduled by older versions
+ */
+int alarm_payload_read(app_control_h app_control, struct alarm_payload *payload)
+{
+	bundle *b = NULL;
+	char *text = NULL;
+
+	if (app_control_to_bundle(app_control, &b) != APP_CONTROL_ERROR_NONE ||
+			bundle_get_str(b, APP_CONTROL_DATA_ALARM_PAYLOAD, &text) != BUNDLE_ERROR_NONE) {
+		return TIZEN_ERROR_NO_DATA;
+	}
+
+	return alarm_payload_decode(text, payload) == TIZEN_ERROR_NONE ? TIZEN_ERROR_NONE : TIZEN_ERROR_NO_DATA;
+}
+
+/* End of file */
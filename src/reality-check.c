@@ -1,429 +1,1522 @@
-/*
- * reality-check.c
- *
- *  Created on: Jan 7, 2018
- *      Author: Florian
- */
-
-#include <tizen_error.h>
-#include <time.h>
-#include <stdlib.h>
-#include <app_alarm.h>
-#include <app_preference.h>
-#include <haptic.h>
-#include <dlog.h>
-#include <Ecore.h>
-
-#include "gear-reality-check.h"
-#include "reality-check.h"
-
-Eina_Bool alarm_vibrate(void* vp_counter);
-
-const char* num_reminders_key = "num_reminders";
-const char* start_time_hours_key = "start_time_hours";
-const char* start_time_mins_key = "start_time_mins";
-const char* end_time_hours_key = "end_time_hours";
-const char* end_time_mins_key = "end_time_mins";
-const char* last_handled_date_key = "last_handled_date";
-
-const int num_times_vibrate = 3;
-const int vibration_msec = 300;
-const int vibration_pause_msec = 300;
-
-typedef struct {
-	haptic_device_h device_handle;
-	haptic_effect_h effect_handle;
-	Ecore_Timer* timer;
-	int counter;
-} vibration_data_s;
-
-
-
-// Plan:
-// To get my personal MVP, I will implement the following:
-// * Fixed number of alarms
-// * Fixed start and end daily
-// * Function to generate random alarms for the active part of the day
-// * Update function called when the last alarm of the day is called
-//
-// From then forward, it's features for more usability
-// * Configurable number of alarms
-// * Configurable start and stop times
-// * Flashing display for alarm (to trigger reality checks related to devices such as Aurora)
-// * Better vibration feature
-// * Better "reality check" screen and dismiss button like the platform alarm app
-
-/** The number of reminders to show per day */
-static int get_target_num_reminders(int* num_reminders)
-{
-	bool exists = false;
-	if (preference_is_existing(num_reminders_key, &exists) == PREFERENCE_ERROR_NONE && exists)
-	{
-		preference_get_int(num_reminders_key, num_reminders);
-		dlog_print(DLOG_INFO, LOG_TAG, "Preferred number of reminders: %d ", *num_reminders);
-	} else
-	{
-		*num_reminders = 5;
-	}
-	return TIZEN_ERROR_NONE;
-}
-
-/** The time of day before which no reality checks should be triggered. Only hours and minutes will be used. */
-static int get_start_time(struct tm* result)
-{
-	//@@TODO: Refactor to use preferences
-	result->tm_hour = 8;
-	result->tm_min = 0;
-	return TIZEN_ERROR_NONE;
-}
-
-/** The time of day after which no reality checks should be triggered. Only hours and minutes will be used. */
-static int get_stop_time(struct tm* result)
-{
-	//@@TODO: Refactor to use preferences
-	result->tm_hour = 22;
-	result->tm_min = 0;
-
-	return TIZEN_ERROR_NONE;
-}
-
-/** Get a random number between min and max */
-static int rand_between(int min, int max)
-{
-	int limit = max - min;
-	return rand() % limit + min;
-}
-
-/** Generate a random time on the specified date, after the time specified in start, before the time specified in end */
-static int generate_time(struct tm date, struct tm start, struct tm end, struct tm* result)
-{
-	struct tm start_date = date;
-	start_date.tm_hour = start.tm_hour;
-	start_date.tm_min = start.tm_min;
-
-	struct tm end_date = date;
-	end_date.tm_hour = end.tm_hour;
-	end_date.tm_min = end.tm_min;
-
-	time_t start_time_t = mktime(&start_date);
-	time_t end_time_t = mktime(&end_date);
-
-	time_t rand_time_t = rand_between(start_time_t, end_time_t);
-
-	localtime_r (&rand_time_t,result);
-
-	return TIZEN_ERROR_NONE;
-}
-
-/** Generate the specified number of alarms on the given date */
-static int generate_times(struct tm date, int num_times, struct tm** result)
-{
-	srand( (unsigned)time( NULL ) );
-	// Initialize the array
-	*result = malloc(sizeof(struct tm) * num_times);
-	struct tm* current = *result;
-
-	struct tm start_time;
-	struct tm end_time;
-	get_start_time(&start_time);
-	get_stop_time(&end_time);
-
-	for (int i = 0; i < num_times;i++)
-	{
-		generate_time(date, start_time, end_time, current);
-		current++;
-	}
-
-	return TIZEN_ERROR_NONE;
-}
-
-/** Schedule alarms on the given dates */
-static int schedule_alarms(app_control_h app_control, int num_alarms, struct tm* alarms)
-{
-	struct tm* current = alarms;
-	int ret;
-	for (int i = 0; i < num_alarms; i++)
-	{
-		int alarm_id;
-		ret = alarm_schedule_at_date(app_control, current, 0, &alarm_id);
-		if (ret != ALARM_ERROR_NONE)
-		        dlog_print(DLOG_ERROR, LOG_TAG, "Get time Error: %d ", ret);
-		dlog_print(DLOG_INFO, LOG_TAG, "New alarm scheduled at: %s ", asctime(current));
-		current++;
-	}
-
-	// @@TODO: Better error handling
-	return TIZEN_ERROR_NONE;
-}
-
-/** Save all registered alarms into an array of tm values. */
-static bool on_foreach_registered_alarm(int alarm_id, void *user_data)
-{
-    int ret = 0;
-    struct tm date;
-
-    ret = alarm_get_scheduled_date(alarm_id, &date);
-    if (ret != ALARM_ERROR_NONE)
-        dlog_print(DLOG_ERROR, LOG_TAG, "Get time Error: %d ", ret);
-
-    struct tm** array = (struct tm**)(user_data);
-    // Write the current date into the array
-    **array = date;
-    // And point to the next element
-    *array += 1;
-
-    return true;
-}
-
-/** Function to count the number of registered alarms. user_data is an int*, must be set to 0 before */
-static bool on_foreach_registered_alarm_count(int alarm_id, void *user_data)
-{
-	int* count = (int*) user_data;
-	*count += 1;
-
-    return true;
-}
-
-
-/** Get all times at which the app already has alarms set */
-static int get_all_alarms(int* num_alarms, struct tm** result)
-{
-	// First, count the numbers of alarms by iterating once over them
-	*num_alarms = 0;
-	int ret = 0;
-	ret = alarm_foreach_registered_alarm(on_foreach_registered_alarm_count, (void*) num_alarms);
-	if (ret != ALARM_ERROR_NONE)
-	    dlog_print(DLOG_ERROR, LOG_TAG, "Listing Error: %d ", ret);
-
-	// Allocate an array large enough
-	*result = malloc(sizeof(struct tm) * *num_alarms);
-
-	struct tm* first_element = *result;
-	struct tm** array_copy = &first_element;
-
-	// And fill the array
-	ret = alarm_foreach_registered_alarm(on_foreach_registered_alarm, (void*) array_copy);
-	if (ret != ALARM_ERROR_NONE)
-	    dlog_print(DLOG_ERROR, LOG_TAG, "Listing Error: %d ", ret);
-
-	return TIZEN_ERROR_NONE;
-}
-
-/** Checks whether the two dates are the same day
- *
- */
-static bool is_same_day(struct tm date, struct tm reference_date)
-{
-	return date.tm_yday == reference_date.tm_yday &&
-			date.tm_mon == reference_date.tm_mon &&
-			date.tm_year == reference_date.tm_year;
-}
-
-/** Retrieves the number of alarms the app has already scheduled on the specified date */
-static int get_num_alarms_date(struct tm date, int* result)
-{
-	int num_alarms = 0;
-	struct tm* array = NULL;
-	get_all_alarms(&num_alarms, &array);
-	struct tm* current = array;
-	for (int i = 0; i < num_alarms; i++)
-	{
-		if (is_same_day(*current, date))
-		{
-			*result += 1;
-		}
-		current++;
-	}
-	free(array);
-	return TIZEN_ERROR_NONE;
-}
-
-/** Gets tomorrow's date */
-static int get_tomorrow(struct tm* result)
-{
-	int ret;
-	ret = alarm_get_current_time(result);
-
-	// Convert to Unix timestamp
-	time_t result_t = mktime(result);
-
-	// Add one day's equivalent in seconds
-	result_t += 24 * 60 * 60;
-
-	// And convert back
-	localtime_r(&result_t, result);
-
-	return TIZEN_ERROR_NONE;
-}
-
-/** Function for updating all alarms. Will check if the alarms for tomorrow are not set up correctly and, if so, set them up */
-int update_alarms(app_control_h app_control)
-{
-	dlog_print(DLOG_INFO, LOG_TAG, "Updating alarms.");
-	struct tm tomorrow;
-	int ret = get_tomorrow(&tomorrow);
-
-	// Check out if we have enough alarms scheduled for tomorrow
-	int num_alarms_tomorrow = 0;
-	get_num_alarms_date(tomorrow, &num_alarms_tomorrow);
-	int target_num_alarms_tomorrow = 0;
-	get_target_num_reminders(&target_num_alarms_tomorrow);
-	if (num_alarms_tomorrow != target_num_alarms_tomorrow)
-	{
-		dlog_print(DLOG_INFO, LOG_TAG, "Wrong number of alarms scheduled for tomorrow, %d instead of %d.", num_alarms_tomorrow, target_num_alarms_tomorrow);
-		// We need to schedule alarms for tomorrow
-		struct tm* generated_times;
-		generate_times(tomorrow, target_num_alarms_tomorrow, &generated_times);
-
-		schedule_alarms(app_control, target_num_alarms_tomorrow, generated_times);
-		free(generated_times);
-	} else
-	{
-		dlog_print(DLOG_INFO, LOG_TAG, "Correct number of alarms scheduled for tomorrow (%d).", num_alarms_tomorrow);
-	}
-
-	// For debug purposes, also schedule today
-	struct tm today;
-	ret = alarm_get_current_time(&today);
-
-	// Check out if we have enough alarms scheduled for today
-	int num_alarms_today;
-	get_num_alarms_date(today, &num_alarms_today);
-	int target_num_alarms_today = 0;
-	get_target_num_reminders(&target_num_alarms_today);
-	if (num_alarms_tomorrow != target_num_alarms_today)
-	{
-		dlog_print(DLOG_INFO, LOG_TAG, "Wrong number of alarms scheduled for today, %d instead of %d.", num_alarms_today, target_num_alarms_today);
-		// We need to schedule alarms for today
-		struct tm* generated_times;
-		generate_times(today, target_num_alarms_today, &generated_times);
-
-		schedule_alarms(app_control, target_num_alarms_today, generated_times);
-		free(generated_times);
-	} else
-	{
-		dlog_print(DLOG_INFO, LOG_TAG, "Correct number of alarms scheduled for today (%d).", num_alarms_today);
-	}
-
-
-
-	// For testing purposes, schedule one in a few seconds
-	bool debug_alarms = false;
-
-	if (debug_alarms)
-	{
-		int alarm_id;
-		struct tm soon;
-		ret = alarm_get_current_time(&soon);
-		soon.tm_sec += 20;
-		ret = alarm_schedule_at_date(app_control, &soon, 0, &alarm_id);
-	}
-
-
-	return TIZEN_ERROR_NONE;
-}
-
-
-/*
- * @brief Starts the vibration pattern for the alarm
- * The parameter counter is incr
- */
-void start_alarm_vibrate()
-{
-	// Prepare the vibration by opening the device
-	// Check how many vibrators we have
-	int device_haptic_count = 0;
-	int ret = 0;
-	ret = device_haptic_get_count(&device_haptic_count);
-
-	if (ret != DEVICE_ERROR_NONE || device_haptic_count == 0)
-	{
-		dlog_print(DLOG_INFO, LOG_TAG, "Error or no haptic devices found.");
-		// Nothing to do in case of error or no haptic devices present
-		return;
-	}
-
-	vibration_data_s* vibration_data = malloc(sizeof(vibration_data_s));
-
-	// Open the first vibrator
-	ret = device_haptic_open(0, &vibration_data->device_handle);
-	if (ret != DEVICE_ERROR_NONE)
-	{
-		dlog_print(DLOG_INFO, LOG_TAG, "Error opening haptic device.");
-		free(vibration_data);
-		return;
-	}
-
-	vibration_data->counter = 0;
-
-	// Start the first vibration
-	alarm_vibrate(vibration_data);
-}
-
-
-/*
- * @brief Callback for the alarm vibration.
- */
-Eina_Bool alarm_vibrate(void* vp_vibration_data)
-{
-	vibration_data_s* vibration_data = (vibration_data_s*) vp_vibration_data;
-	dlog_print(DLOG_INFO, LOG_TAG, "Entered alarm_vibrate, counter: %d", vibration_data->counter);
-	if (vibration_data->counter < num_times_vibrate)
-	{
-		// Start vibrating
-		int ret = device_haptic_vibrate(vibration_data->device_handle, vibration_msec, 100, &vibration_data->effect_handle);
-		if (ret != DEVICE_ERROR_NONE)
-		{
-			dlog_print(DLOG_ERROR, LOG_TAG, "Error starting vibration.");
-			return EINA_FALSE;
-		}
-
-		if (vibration_data->counter == 0)
-		{
-			dlog_print(DLOG_INFO, LOG_TAG, "Starting timer for %d msec", vibration_msec + vibration_pause_msec);
-			// If this is the first time, we also need to set up the timer
-			vibration_data->timer = ecore_timer_add(((double)(vibration_msec + vibration_pause_msec)) / 1000.0 , alarm_vibrate, vibration_data);
-			if (!vibration_data->timer)
-			{
-				dlog_print(DLOG_INFO, LOG_TAG, "Error starting timer.");
-			}
-		}
-	} else
-	{
-		// We need to stop vibrating
-		int ret = device_haptic_close(vibration_data->device_handle);
-		if (ret != DEVICE_ERROR_NONE)
-		{
-			dlog_print(DLOG_INFO, LOG_TAG, "Error closing haptic device.");
-			return EINA_FALSE;
-		}
-		free(vibration_data);
-		return EINA_FALSE;
-	}
-
-	vibration_data->counter += 1;
-	return EINA_TRUE;
-}
-
-
- void test()
-{
-	/* struct tm today;
-	alarm_get_current_time(&today);
-	int num_times = 0;
-	get_target_num_reminders(&num_times);
-	struct tm* result;
-	generate_times(today, num_times, &result);
-
-	struct tm* current = result;
-	for (int i = 0; i < num_times; i++)
-	{
-		int hours = current->tm_hour;
-		int minutes = current->tm_min;
-		current++;
-	}
-
-	free(result); */
-}
-
-
+/*
+ * reality-check.c
+ *
+ *  Created on: Jan 7, 2018
+ *      Author: Florian
+ */
+
+#include <tizen_error.h>
+#include <time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <app_alarm.h>
+#include <app_preference.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "reality-check.h"
+#include "schedule.h"
+#include "payload.h"
+#include "cue.h"
+#include "history.h"
+#include "stats.h"
+#include "alias-table.h"
+
+const char* num_reminders_key = "num_reminders";
+const char* start_time_hours_key = "start_time_hours";
+const char* start_time_mins_key = "start_time_mins";
+const char* end_time_hours_key = "end_time_hours";
+const char* end_time_mins_key = "end_time_mins";
+const char* last_handled_date_key = "last_handled_date";
+const char* streak_days_key = "streak_days";
+const char* streak_last_day_key = "streak_last_day";
+const char* planning_horizon_key = "planning_horizon_days";
+const char* planned_until_key = "planned_until";
+const char* planner_wake_alarm_key = "planner_wake_alarm_id";
+const char* missed_total_key = "missed_total";
+const char* missed_last_day_key = "missed_last_day";
+const char* missed_last_day_count_key = "missed_last_day_count";
+const char* coalesce_window_key = "coalesce_window_mins";
+const char* coalesce_saved_key = "coalesce_saved";
+const char* plan_generation_key = "plan_generation";
+const char* adaptive_sampling_key = "adaptive_sampling";
+const char* weekly_quota_key = "weekly_quota";
+const char* week_start_key = "week_start";
+const char* week_delivered_key = "week_delivered";
+const char* standard_offset_key = "utc_standard_offset";
+const char* day_used_key = "day_used";
+const char* day_used_count_key = "day_used_count";
+
+const int default_planning_horizon_days = 3;
+const int default_coalesce_window_mins = 10;
+
+/** Reminders this close to the start or the end of the window get the gentle cue */
+const time_t cue_gentle_edge_seconds = 30 * 60;
+
+/** A reminder that went off this long ago is still being delivered, not missed */
+const int64_t catch_up_grace_seconds = 2 * 60;
+
+/** The response rate of an hour counts as this many reminders at the overall response rate, so a few reminders do not decide it */
+const double adaptive_prior_reminders = 4.0;
+/** No hour is weighted below this response rate, so the hours that are ignored now are still tried now and then */
+const double adaptive_min_rate = 0.05;
+
+/** The hours of the active window the adaptive sampler draws from. The alias table is built again only when the weights change. */
+static struct adaptive_sampler
+{
+	int num_slots;
+	time_t bounds[ALIAS_TABLE_MAX + 1];
+	double weights[ALIAS_TABLE_MAX];
+	struct alias_table table;
+} sampler = { 0 };
+
+#define DAYS_A_WEEK 7
+
+/** A weekday on which the history shows more missed reminders counts as at least this share of a day */
+const double weekly_min_presence = 0.25;
+
+/** The targets of the days of a week, computed for the whole week in one pass. week_start is 0 when it has to be computed. */
+static struct week_plan
+{
+	int64_t week_start;
+	int64_t days[DAYS_A_WEEK];
+	int targets[DAYS_A_WEEK];
+} week_plan = { 0 };
+
+/** The generation of the plan, read from the preferences once and cached. 0 until it is known. */
+static unsigned int plan_generation = 0;
+
+// Plan:
+// To get my personal MVP, I will implement the following:
+// * Fixed number of alarms
+// * Fixed start and end daily
+// * Function to generate random alarms for the active part of the day
+// * Update function called when the last alarm of the day is called
+//
+// From then forward, it's features for more usability
+// * Configurable number of alarms
+// * Configurable start and stop times
+// * Flashing display for alarm (to trigger reality checks related to devices such as Aurora)
+// * Better vibration feature
+// * Better "reality check" screen and dismiss button like the platform alarm app
+
+/** The number of reminders to show per day */
+static int get_target_num_reminders(int* num_reminders)
+{
+	bool exists = false;
+	if (preference_is_existing(num_reminders_key, &exists) == PREFERENCE_ERROR_NONE && exists)
+	{
+		preference_get_int(num_reminders_key, num_reminders);
+		dlog_print(DLOG_INFO, LOG_TAG, "Preferred number of reminders: %d ", *num_reminders);
+	} else
+	{
+		*num_reminders = 5;
+	}
+	return TIZEN_ERROR_NONE;
+}
+
+/** Reads an hour and a minute from preferences, using the defaults if they are not set */
+static void get_time_of_day(const char* hours_key, const char* mins_key, int default_hours, struct tm* result)
+{
+	if (preference_get_int(hours_key, &result->tm_hour) != PREFERENCE_ERROR_NONE ||
+		preference_get_int(mins_key, &result->tm_min) != PREFERENCE_ERROR_NONE)
+	{
+		result->tm_hour = default_hours;
+		result->tm_min = 0;
+	}
+}
+
+/** The time of day before which no reality checks should be triggered. Only hours and minutes will be used. */
+static int get_start_time(struct tm* result)
+{
+	get_time_of_day(start_time_hours_key, start_time_mins_key, 8, result);
+	return TIZEN_ERROR_NONE;
+}
+
+/** The time of day after which no reality checks should be triggered. Only hours and minutes will be used. */
+static int get_stop_time(struct tm* result)
+{
+	get_time_of_day(end_time_hours_key, end_time_mins_key, 22, result);
+	return TIZEN_ERROR_NONE;
+}
+
+/** Get a random number between min and max */
+static int rand_between(int min, int max)
+{
+	int limit = max - min;
+	if (limit <= 0)
+	{
+		return min;
+	}
+	return rand() % limit + min;
+}
+
+/** Gets the active window on the given day, from the start time to the stop time */
+static void get_window(int64_t day, time_t* from, time_t* to)
+{
+	struct tm start;
+	struct tm end;
+	get_start_time(&start);
+	get_stop_time(&end);
+
+	time_t day_t = (time_t) day;
+	struct tm start_date;
+	localtime_r(&day_t, &start_date);
+	struct tm end_date = start_date;
+
+	start_date.tm_hour = start.tm_hour;
+	start_date.tm_min = start.tm_min;
+	start_date.tm_sec = 0;
+	start_date.tm_isdst = -1;
+
+	end_date.tm_hour = end.tm_hour;
+	end_date.tm_min = end.tm_min;
+	end_date.tm_sec = 0;
+	end_date.tm_isdst = -1;
+
+	*from = mktime(&start_date);
+	*to = mktime(&end_date);
+}
+
+/** Compare function for sorting times */
+static int compare_times(const void* a, const void* b)
+{
+	time_t time_a = *(const time_t*) a;
+	time_t time_b = *(const time_t*) b;
+
+	return (time_a > time_b) - (time_a < time_b);
+}
+
+/** Whether reminder times are drawn by the response rates of the hours instead of uniformly */
+static bool get_adaptive_sampling()
+{
+	bool adaptive = false;
+	if (preference_get_boolean(adaptive_sampling_key, &adaptive) != PREFERENCE_ERROR_NONE)
+	{
+		return false;
+	}
+	return adaptive;
+}
+
+/** Estimates a response rate from its counts, pulled towards the prior rate when there are few reminders */
+static double estimate_response_rate(const struct stats_summary* summary, double prior_rate)
+{
+	unsigned int due = summary->shown + summary->missed;
+	return (summary->dismissed + adaptive_prior_reminders * prior_rate) / (due + adaptive_prior_reminders);
+}
+
+/**
+ * Estimates the response rate of an hour of a weekday from the history. The hour on every weekday is the prior
+ * of the hour on one weekday, the overall rate is the prior of the hour on every weekday.
+ */
+static double get_hour_response_rate(int weekday, int hour, double overall_rate)
+{
+	struct stats_summary summary;
+	stats_get(STATS_ALL, hour, &summary);
+	double hour_rate = estimate_response_rate(&summary, overall_rate);
+
+	stats_get(weekday, hour, &summary);
+	double rate = estimate_response_rate(&summary, hour_rate);
+
+	return rate > adaptive_min_rate ? rate : adaptive_min_rate;
+}
+
+/**
+ * Splits the window from from to to into hours and weights each hour by its length and its response rate.
+ * The alias table is built again if the weights have changed. Returns false if the window is empty.
+ */
+static bool prepare_adaptive_sampler(time_t from, time_t to)
+{
+	// The other process may have recorded responses since the rollups were updated
+	stats_refresh();
+
+	struct stats_summary overall;
+	stats_get(STATS_ALL, STATS_ALL, &overall);
+	double overall_rate = 0.5;
+	if (overall.shown + overall.missed > 0)
+	{
+		overall_rate = overall.response_rate_permille / 1000.0;
+	}
+
+	double weights[ALIAS_TABLE_MAX];
+	int num_slots = 0;
+	time_t start = from;
+	sampler.bounds[0] = from;
+
+	while (start < to && num_slots < ALIAS_TABLE_MAX)
+	{
+		struct tm date;
+		localtime_r(&start, &date);
+
+		// The start of the next hour, mktime() handles the end of the day and changes of the daylight saving time
+		struct tm next_date = date;
+		next_date.tm_hour += 1;
+		next_date.tm_min = 0;
+		next_date.tm_sec = 0;
+		next_date.tm_isdst = -1;
+		time_t end = mktime(&next_date);
+		if (end <= start || end > to || num_slots == ALIAS_TABLE_MAX - 1)
+		{
+			end = to;
+		}
+
+		weights[num_slots] = (double) (end - start) * get_hour_response_rate(date.tm_wday, date.tm_hour, overall_rate);
+		sampler.bounds[++num_slots] = end;
+		start = end;
+	}
+
+	if (num_slots == 0)
+	{
+		return false;
+	}
+
+	if (num_slots != sampler.num_slots || memcmp(weights, sampler.weights, sizeof(double) * num_slots) != 0)
+	{
+		if (alias_table_build(&sampler.table, weights, num_slots) != TIZEN_ERROR_NONE)
+		{
+			sampler.num_slots = 0;
+			return false;
+		}
+		memcpy(sampler.weights, weights, sizeof(double) * num_slots);
+		sampler.num_slots = num_slots;
+		dlog_print(DLOG_INFO, LOG_TAG, "Adaptive sampler built for %d hours, overall response rate %.2f", num_slots, overall_rate);
+	}
+
+	return true;
+}
+
+/** Draws a time from the prepared adaptive sampler: an hour from the alias table, then a time in the hour */
+static time_t draw_adaptive_time()
+{
+	int slot = alias_table_draw(&sampler.table);
+	// The offset within the slot fits an int, the epoch seconds do not after 2038
+	return sampler.bounds[slot] + rand_between(0, (int) (sampler.bounds[slot + 1] - sampler.bounds[slot]));
+}
+
+/**
+ * Generate the specified number of alarm times between from and to, sorted from early to late.
+ * In adaptive mode, the times are drawn by the response rates of the hours, otherwise uniformly.
+ */
+static int generate_times(time_t from, time_t to, int num_times, time_t** result)
+{
+	// Seed once, days planned in one batch would otherwise get the same times
+	static bool seeded = false;
+	if (!seeded)
+	{
+		srand( (unsigned)time( NULL ) );
+		seeded = true;
+	}
+	// Initialize the array
+	*result = malloc(sizeof(time_t) * num_times);
+	if (*result == NULL)
+	{
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to allocate %d alarm times.", num_times);
+		return TIZEN_ERROR_OUT_OF_MEMORY;
+	}
+
+	bool adaptive = get_adaptive_sampling() && prepare_adaptive_sampler(from, to);
+
+	for (int i = 0; i < num_times;i++)
+	{
+		(*result)[i] = adaptive ? draw_adaptive_time() : rand_between(from, to);
+	}
+
+	// Sorted times are appended to the end of the schedule store
+	qsort(*result, num_times, sizeof(time_t), compare_times);
+
+	return TIZEN_ERROR_NONE;
+}
+
+/**
+ * Schedule alarms at the given times and add them to the schedule store.
+ * Each reminder carries its payload, first_slot is the slot of the first reminder in its day, -1 if it is not known.
+ */
+/**
+ * Picks the cue of a reminder. The first and the last half hour of the window get the gentle cue,
+ * the other reminders alternate between the alarm and the aurora by slot, so the cue does not fade into the background.
+ */
+static int choose_cue_pattern(time_t when, int slot)
+{
+	time_t window_from;
+	time_t window_to;
+	get_window(schedule_day_start((int64_t) when), &window_from, &window_to);
+
+	if (when - window_from < cue_gentle_edge_seconds || window_to - when < cue_gentle_edge_seconds)
+	{
+		return CUE_PATTERN_GENTLE;
+	}
+	return slot > 0 && slot % 2 ? CUE_PATTERN_AURORA : CUE_PATTERN_ALARM;
+}
+
+static int schedule_alarms(app_control_h app_control, int first_slot, int num_alarms, const time_t* alarms)
+{
+	struct alarm_payload payload;
+	int ret;
+
+	payload.plan_generation = get_plan_generation();
+	payload.kind = SCHEDULE_ORIGIN_PLANNER;
+
+	for (int i = 0; i < num_alarms; i++)
+	{
+		int alarm_id;
+		struct tm date;
+		localtime_r(&alarms[i], &date);
+
+		payload.epoch = (int64_t) alarms[i];
+		payload.slot = first_slot >= 0 ? first_slot + i : -1;
+		payload.pattern = choose_cue_pattern(alarms[i], payload.slot);
+
+		ret = alarm_payload_schedule(app_control, &payload, &date, &alarm_id);
+		if (ret != ALARM_ERROR_NONE)
+		{
+			dlog_print(DLOG_ERROR, LOG_TAG, "Get time Error: %d ", ret);
+			continue;
+		}
+		schedule_store_add(alarms[i], alarm_id, SCHEDULE_STATE_PENDING, SCHEDULE_ORIGIN_PLANNER);
+		dlog_print(DLOG_INFO, LOG_TAG, "New alarm scheduled at: %s ", asctime(&date));
+	}
+
+	// @@TODO: Better error handling
+	return TIZEN_ERROR_NONE;
+}
+
+/** The minimum distance between two reminders in seconds, 0 turns coalescing off */
+static int get_coalesce_window()
+{
+	int window = default_coalesce_window_mins;
+	if (preference_get_int(coalesce_window_key, &window) != PREFERENCE_ERROR_NONE || window < 0)
+	{
+		window = default_coalesce_window_mins;
+	}
+	return window * 60;
+}
+
+/** Reads the per-day counts of saved wake-ups, stored as "yyyymmdd:count" pairs. Returns the number of days read. */
+static int read_coalesce_saved(int* day_keys, int* counts)
+{
+	char* value = NULL;
+	int num_days = 0;
+	int offset = 0;
+	int length = 0;
+
+	if (preference_get_string(coalesce_saved_key, &value) != PREFERENCE_ERROR_NONE || value == NULL)
+	{
+		return 0;
+	}
+
+	while (num_days < COALESCE_SAVED_DAYS &&
+		sscanf(value + offset, "%d:%d;%n", &day_keys[num_days], &counts[num_days], &length) == 2)
+	{
+		num_days++;
+		offset += length;
+	}
+
+	free(value);
+	return num_days;
+}
+
+/** Adds wake-ups saved by coalescing to the count of a day. The oldest day is dropped when the list is full. */
+static void add_coalesce_saved(int64_t day, int saved)
+{
+	int day_keys[COALESCE_SAVED_DAYS + 1];
+	int counts[COALESCE_SAVED_DAYS + 1];
+	char value[COALESCE_SAVED_LEN] = { 0, };
+	int day_key = schedule_day_key(day);
+	int num_days = read_coalesce_saved(day_keys, counts);
+	int length = 0;
+	int i = 0;
+
+	for (i = 0; i < num_days && day_keys[i] != day_key; i++);
+
+	if (i == num_days)
+	{
+		day_keys[num_days] = day_key;
+		counts[num_days++] = 0;
+	}
+	counts[i] += saved;
+
+	// Drop the oldest day, the list is small and kept in no particular order
+	if (num_days > COALESCE_SAVED_DAYS)
+	{
+		int oldest = 0;
+		for (i = 1; i < num_days; i++)
+		{
+			if (day_keys[i] < day_keys[oldest])
+			{
+				oldest = i;
+			}
+		}
+		day_keys[oldest] = day_keys[--num_days];
+		counts[oldest] = counts[num_days];
+	}
+
+	for (i = 0; i < num_days; i++)
+	{
+		length += snprintf(value + length, sizeof(value) - length, "%d:%d;", day_keys[i], counts[i]);
+	}
+	preference_set_string(coalesce_saved_key, value);
+}
+
+/** Gets the number of wake-ups coalescing saved on a day */
+int get_coalesce_saved(int64_t day)
+{
+	int day_keys[COALESCE_SAVED_DAYS];
+	int counts[COALESCE_SAVED_DAYS];
+	int day_key = schedule_day_key(day);
+	int num_days = read_coalesce_saved(day_keys, counts);
+
+	for (int i = 0; i < num_days; i++)
+	{
+		if (day_keys[i] == day_key)
+		{
+			return counts[i];
+		}
+	}
+	return 0;
+}
+
+/** Inserts a time into a sorted array that has room for it */
+static void insert_time(time_t* times, int* num_times, time_t time)
+{
+	int i = *num_times;
+	while (i > 0 && times[i - 1] > time)
+	{
+		times[i] = times[i - 1];
+		i--;
+	}
+	times[i] = time;
+	(*num_times)++;
+}
+
+/**
+ * Finds the time between from and to that is closest to the wanted time and at least window away from all taken times.
+ * Returns false if there is no such time.
+ */
+static bool find_free_time(const time_t* taken, int num_taken, time_t from, time_t to, int window, time_t* wanted)
+{
+	bool found = false;
+	time_t best = 0;
+
+	// Each gap between two taken times, and before the first and after the last, is a range of free times
+	for (int i = 0; i <= num_taken; i++)
+	{
+		time_t gap_from = i > 0 ? taken[i - 1] + window : from;
+		time_t gap_to = i < num_taken ? taken[i] - window : to;
+		gap_from = gap_from > from ? gap_from : from;
+		gap_to = gap_to < to ? gap_to : to;
+		if (gap_from > gap_to)
+		{
+			continue;
+		}
+
+		time_t candidate = *wanted < gap_from ? gap_from : (*wanted > gap_to ? gap_to : *wanted);
+		if (!found || labs((long) (candidate - *wanted)) < labs((long) (best - *wanted)))
+		{
+			best = candidate;
+			found = true;
+		}
+	}
+
+	if (found)
+	{
+		*wanted = best;
+	}
+	return found;
+}
+
+/**
+ * Coalesces new reminder times with each other and with the reminders of the day in the schedule store,
+ * before they are registered. A time closer than the coalescing window to another reminder is respaced
+ * to the closest free time between from and to. If there is no room left, it is merged into its neighbour,
+ * which saves a wake-up. The times stay sorted.
+ * Returns the number of times left, saved is set to the number of merged times.
+ */
+static int coalesce_times(int64_t day, time_t from, time_t to, time_t* times, int num_times, int* saved)
+{
+	int window = get_coalesce_window();
+	*saved = 0;
+	if (window == 0)
+	{
+		return num_times;
+	}
+
+	int first = 0;
+	int count = schedule_store_range(day, day, &first);
+	time_t taken[count + num_times + 1];
+	int num_taken = 0;
+	int num_kept = 0;
+
+	for (int i = first; i < first + count; i++)
+	{
+		if (schedule_store_get_state(i) != SCHEDULE_STATE_OFF)
+		{
+			taken[num_taken++] = (time_t) schedule_store_get_epoch(i);
+		}
+	}
+
+	for (int i = 0; i < num_times; i++)
+	{
+		time_t wanted = times[i];
+		if (!find_free_time(taken, num_taken, from, to, window, &wanted))
+		{
+			(*saved)++;
+			continue;
+		}
+
+		insert_time(taken, &num_taken, wanted);
+		times[num_kept++] = wanted;
+	}
+
+	qsort(times, num_kept, sizeof(time_t), compare_times);
+
+	return num_kept;
+}
+
+/** Cancels a planned reminder and removes it from the schedule store */
+static void cancel_alarm(int alarm_id)
+{
+	alarm_cancel(alarm_id);
+	schedule_store_remove(alarm_id);
+}
+
+/** Formats the date of a day for the log */
+static void get_day_name(int64_t day, char* day_name, int day_name_len)
+{
+	time_t day_t = (time_t) day;
+	struct tm date;
+	localtime_r(&day_t, &date);
+	strftime(day_name, day_name_len, "%Y-%m-%d", &date);
+}
+
+/** The number of reminders per week, 0 if the number of reminders is set per day */
+int get_weekly_quota()
+{
+	int quota = 0;
+	if (preference_get_int(weekly_quota_key, &quota) != PREFERENCE_ERROR_NONE || quota < 0)
+	{
+		return 0;
+	}
+	return quota;
+}
+
+/** The start of the week of the given time. Weeks start on Monday. */
+static int64_t get_week_start(int64_t epoch)
+{
+	int64_t day = schedule_day_start(epoch);
+	time_t day_t = (time_t) day;
+	struct tm date;
+	localtime_r(&day_t, &date);
+
+	// Noon of the Monday, so a change of the daylight saving time in between does not move to another day
+	int days_since_monday = (date.tm_wday + DAYS_A_WEEK - 1) % DAYS_A_WEEK;
+	return schedule_day_start(day + 12 * 60 * 60 - (int64_t) days_since_monday * 24 * 60 * 60);
+}
+
+/** The number of reminders delivered in the given week */
+static int get_week_delivered(int64_t week_start)
+{
+	double stored_week = 0;
+	int delivered = 0;
+	if (preference_get_double(week_start_key, &stored_week) != PREFERENCE_ERROR_NONE ||
+		(int64_t) stored_week != week_start ||
+		preference_get_int(week_delivered_key, &delivered) != PREFERENCE_ERROR_NONE)
+	{
+		return 0;
+	}
+	return delivered;
+}
+
+/**
+ * The number of reminders of the planner on the given day that have been delivered or missed.
+ * The schedule store only has the reminders that are still registered after a restart, so the count is kept in a preference.
+ */
+static int get_day_used(int64_t day)
+{
+	double used_day = 0;
+	int used = 0;
+	if (preference_get_double(day_used_key, &used_day) != PREFERENCE_ERROR_NONE ||
+		(int64_t) used_day != day ||
+		preference_get_int(day_used_count_key, &used) != PREFERENCE_ERROR_NONE)
+	{
+		return 0;
+	}
+	return used;
+}
+
+/** Counts a reminder of the planner that has been delivered or missed against the target of its day. Only the latest day is kept. */
+static void note_day_used(int64_t epoch)
+{
+	int64_t day = schedule_day_start(epoch);
+	double used_day = 0;
+	if (preference_get_double(day_used_key, &used_day) == PREFERENCE_ERROR_NONE && (int64_t) used_day > day)
+	{
+		return;
+	}
+
+	preference_set_int(day_used_count_key, get_day_used(day) + 1);
+	preference_set_double(day_used_key, (double) day);
+}
+
+/** Counts a reminder of the planner that has been delivered against the quota of its week and the target of its day */
+void note_reminder_delivered(int64_t now)
+{
+	note_day_used(now);
+
+	int64_t week_start = get_week_start(now);
+	int delivered = get_week_delivered(week_start);
+
+	preference_set_double(week_start_key, (double) week_start);
+	preference_set_int(week_delivered_key, delivered + 1);
+}
+
+/** The number of reminders of the weekly quota that have not been delivered this week, 0 if there is no weekly quota */
+int get_remaining_weekly_quota(int64_t now)
+{
+	int remaining = get_weekly_quota() - get_week_delivered(get_week_start(now));
+	return remaining > 0 ? remaining : 0;
+}
+
+/** The most reminders the weekly plan gives a day, twice its even share of the quota */
+static int get_week_day_limit(int quota)
+{
+	return (2 * quota + DAYS_A_WEEK - 1) / DAYS_A_WEEK;
+}
+
+/** Makes the next target query compute the week again, after the settings, the time or the deliveries have changed */
+static void invalidate_week_plan()
+{
+	week_plan.week_start = 0;
+}
+
+/**
+ * Distributes what is left of the weekly quota over the rest of the week in one pass.
+ * Each day gets a share by the length of the future part of its active window, weighted by how rarely
+ * reminders are missed on its weekday. Reminders that were missed earlier in the week are not delivered,
+ * so they are distributed over the rest of the week again. No day gets more than twice its even share.
+ */
+static void plan_week(int64_t week_start, int64_t now)
+{
+	stats_refresh();
+
+	int quota = get_weekly_quota();
+	int remaining = quota - (week_start == get_week_start(now) ? get_week_delivered(week_start) : 0);
+	int max_per_day = get_week_day_limit(quota);
+	double weights[DAYS_A_WEEK];
+	double fractions[DAYS_A_WEEK];
+	double total_weight = 0;
+	int assigned = 0;
+
+	int64_t day = week_start;
+	for (int i = 0; i < DAYS_A_WEEK; i++, day = schedule_day_next(day))
+	{
+		time_t window_from;
+		time_t window_to;
+		get_window(day, &window_from, &window_to);
+		time_t from = window_from > (time_t) now ? window_from : (time_t) now + 1;
+
+		weights[i] = 0;
+		if (from < window_to)
+		{
+			struct stats_summary summary;
+			time_t day_t = (time_t) day;
+			struct tm date;
+			localtime_r(&day_t, &date);
+			stats_get(date.tm_wday, STATS_ALL, &summary);
+
+			double presence = 1.0;
+			unsigned int due = summary.shown + summary.missed;
+			if (due > 0)
+			{
+				presence = 1.0 - (double) summary.missed / due;
+			}
+			if (presence < weekly_min_presence)
+			{
+				presence = weekly_min_presence;
+			}
+			weights[i] = (double) (window_to - from) * presence;
+		}
+
+		week_plan.days[i] = day;
+		week_plan.targets[i] = 0;
+		total_weight += weights[i];
+	}
+
+	if (remaining > 0 && total_weight > 0)
+	{
+		// Largest remainder: every day gets the whole part of its share, the rest goes to the largest fractions
+		for (int i = 0; i < DAYS_A_WEEK; i++)
+		{
+			double share = remaining * weights[i] / total_weight;
+			week_plan.targets[i] = (int) share;
+			fractions[i] = share - week_plan.targets[i];
+			assigned += week_plan.targets[i];
+		}
+
+		for (; assigned < remaining; assigned++)
+		{
+			int largest = 0;
+			for (int i = 1; i < DAYS_A_WEEK; i++)
+			{
+				if (fractions[i] > fractions[largest])
+				{
+					largest = i;
+				}
+			}
+			week_plan.targets[largest]++;
+			fractions[largest] = -1;
+		}
+
+		for (int i = 0; i < DAYS_A_WEEK; i++)
+		{
+			if (week_plan.targets[i] > max_per_day)
+			{
+				week_plan.targets[i] = max_per_day;
+			}
+		}
+	}
+
+	week_plan.week_start = week_start;
+
+	char day_name[16];
+	get_day_name(week_start, day_name, sizeof(day_name));
+	dlog_print(DLOG_INFO, LOG_TAG, "Week of %s: quota %d, remaining %d, targets %d %d %d %d %d %d %d.", day_name, quota,
+		remaining > 0 ? remaining : 0, week_plan.targets[0], week_plan.targets[1], week_plan.targets[2],
+		week_plan.targets[3], week_plan.targets[4], week_plan.targets[5], week_plan.targets[6]);
+}
+
+/** The number of reminders the weekly plan gives to the future part of the given day */
+static int get_week_day_target(int64_t day, int64_t now)
+{
+	int64_t week_start = get_week_start(day);
+	if (week_plan.week_start != week_start)
+	{
+		plan_week(week_start, now);
+	}
+
+	for (int i = 0; i < DAYS_A_WEEK; i++)
+	{
+		if (week_plan.days[i] == day)
+		{
+			return week_plan.targets[i];
+		}
+	}
+	return 0;
+}
+
+/**
+ * Brings the future part of a day in line with the settings.
+ * Reminders that are delivered or in the past are kept, as are planned reminders that are still inside the window.
+ * Reminders outside the window are cancelled, then reminders are cancelled from the end or added until
+ * the future part of the window has its share of the target number. The reminders of the day that are
+ * delivered, missed or past count against the target, so a settings change does not refill the rest of the day.
+ * Returns the number of calls to the alarm service.
+ */
+static int plan_day(app_control_h app_control, int64_t day, int64_t now, const char* day_name)
+{
+	time_t window_from;
+	time_t window_to;
+	get_window(day, &window_from, &window_to);
+
+	// Only the future part of the window is planned
+	time_t from = window_from > (time_t) now ? window_from : (time_t) now + 1;
+
+	// The store changes while cancelling, so the reminders to cancel are collected first
+	int first = 0;
+	int count = schedule_store_range(day, day, &first);
+	int kept_ids[count + 1];
+	int num_kept = 0;
+	int cancel_ids[count + 1];
+	int num_cancel = 0;
+	int num_past = 0;
+
+	for (int i = first; i < first + count; i++)
+	{
+		int64_t epoch = schedule_store_get_epoch(i);
+		if (schedule_store_get_origin(i) != SCHEDULE_ORIGIN_PLANNER)
+		{
+			continue;
+		}
+
+		enum schedule_state state = schedule_store_get_state(i);
+		if (state == SCHEDULE_STATE_DELIVERED || state == SCHEDULE_STATE_MISSED ||
+			(state == SCHEDULE_STATE_PENDING && epoch <= now))
+		{
+			// These have used up part of the day's target
+			num_past++;
+			continue;
+		}
+		if (state != SCHEDULE_STATE_PENDING)
+		{
+			continue;
+		}
+
+		if (epoch < window_from || epoch > window_to)
+		{
+			cancel_ids[num_cancel++] = schedule_store_get_alarm_id(i);
+		} else
+		{
+			kept_ids[num_kept++] = schedule_store_get_alarm_id(i);
+		}
+	}
+
+	int target = 0;
+	int day_limit = 0;
+	int quota = get_weekly_quota();
+	if (from >= window_to)
+	{
+		target = 0;
+	} else if (quota > 0)
+	{
+		// The weekly plan already gives the future part of today its share
+		target = get_week_day_target(day, now);
+		day_limit = get_week_day_limit(quota);
+	} else
+	{
+		// The future part of the window gets its share of the target number
+		get_target_num_reminders(&target);
+		day_limit = target;
+		if (from > window_from)
+		{
+			target = (int) (((int64_t) target * (window_to - from) + (window_to - window_from) / 2) / (window_to - window_from));
+		}
+	}
+
+	// What the day has had so far is not given again. After a restart, the store no longer has
+	// the reminders that went off, the count kept for the day still has them.
+	int num_used = get_day_used(day);
+	if (num_past < num_used)
+	{
+		num_past = num_used;
+	}
+	if (target > day_limit - num_past)
+	{
+		target = day_limit > num_past ? day_limit - num_past : 0;
+	}
+
+	// The latest reminders go first if there are too many
+	while (num_kept > target)
+	{
+		cancel_ids[num_cancel++] = kept_ids[--num_kept];
+	}
+
+	for (int i = 0; i < num_cancel; i++)
+	{
+		cancel_alarm(cancel_ids[i]);
+	}
+
+	int needed = target - num_kept;
+	int saved = 0;
+	if (needed > 0)
+	{
+		time_t* generated_times;
+		if (generate_times(from, window_to, needed, &generated_times) != TIZEN_ERROR_NONE)
+		{
+			return num_cancel;
+		}
+
+		needed = coalesce_times(day, from, window_to, generated_times, needed, &saved);
+		schedule_alarms(app_control, num_kept, needed, generated_times);
+		free(generated_times);
+
+		if (saved > 0)
+		{
+			add_coalesce_saved(day, saved);
+		}
+	} else
+	{
+		needed = 0;
+	}
+
+	if (num_cancel || needed)
+	{
+		dlog_print(DLOG_INFO, LOG_TAG, "Planned %s: kept %d, cancelled %d, added %d, coalesced %d.", day_name, num_kept, num_cancel, needed, saved);
+	} else
+	{
+		dlog_print(DLOG_INFO, LOG_TAG, "Correct number of alarms scheduled for %s (%d).", day_name, num_kept);
+	}
+
+	return num_cancel + needed;
+}
+
+/** The number of days, starting today, that are kept planned */
+static int get_planning_horizon()
+{
+	int horizon = 0;
+	if (preference_get_int(planning_horizon_key, &horizon) != PREFERENCE_ERROR_NONE || horizon < 1)
+	{
+		horizon = default_planning_horizon_days;
+	}
+	return horizon;
+}
+
+/** The start of the first day that has not been planned yet, 0 if nothing has been planned */
+static int64_t get_planned_until()
+{
+	// The day is stored as double, preferences have no 64 bit integers
+	double planned_until = 0;
+	if (preference_get_double(planned_until_key, &planned_until) != PREFERENCE_ERROR_NONE)
+	{
+		return 0;
+	}
+	return (int64_t) planned_until;
+}
+
+/**
+ * The generation of the current plan. Reminders carry it in their payload, so a reminder of an older plan
+ * is told apart when it goes off, without reading the schedule store.
+ */
+unsigned int get_plan_generation()
+{
+	int generation = 0;
+	if (plan_generation == 0 &&
+		preference_get_int(plan_generation_key, &generation) == PREFERENCE_ERROR_NONE)
+	{
+		plan_generation = (unsigned int) generation;
+	}
+	return plan_generation;
+}
+
+/**
+ * Starts a new plan generation. The generation is taken from the clock, so it differs from the generation
+ * of reminders left over from before the preferences were cleared.
+ */
+static void start_plan_generation(int64_t now)
+{
+	unsigned int generation = (unsigned int) now;
+	if (generation == 0 || generation == get_plan_generation())
+	{
+		generation++;
+	}
+	plan_generation = generation;
+	preference_set_int(plan_generation_key, (int) generation);
+	dlog_print(DLOG_INFO, LOG_TAG, "Plan generation %u", generation);
+}
+
+/** Gets the ID of the alarm that wakes the planner, -1 if there is none */
+int get_planner_wake_alarm_id()
+{
+	int alarm_id = -1;
+	if (preference_get_int(planner_wake_alarm_key, &alarm_id) != PREFERENCE_ERROR_NONE)
+	{
+		return -1;
+	}
+	return alarm_id;
+}
+
+/** Makes sure the planner is woken at the start of the given day. An alarm that is already set for it is kept. */
+static int arm_planner_wake(int64_t day)
+{
+	int alarm_id = get_planner_wake_alarm_id();
+	struct tm date;
+
+	if (alarm_id >= 0 && alarm_get_scheduled_date(alarm_id, &date) == ALARM_ERROR_NONE)
+	{
+		date.tm_isdst = -1;
+		if ((int64_t) mktime(&date) == day)
+		{
+			return TIZEN_ERROR_NONE;
+		}
+		alarm_cancel(alarm_id);
+	}
+
+	app_control_h wake_control;
+	int ret = app_control_create(&wake_control);
+	if (ret != APP_CONTROL_ERROR_NONE)
+	{
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to create the planner wake app_control: %d", ret);
+		return ret;
+	}
+	app_control_set_operation(wake_control, APP_CONTROL_OPERATION_PLANNER_WAKE);
+	app_control_set_app_id(wake_control, PLANNER_WAKE_APP_ID);
+
+	time_t day_t = (time_t) day;
+	localtime_r(&day_t, &date);
+	ret = alarm_schedule_at_date(wake_control, &date, 0, &alarm_id);
+	app_control_destroy(wake_control);
+
+	if (ret != ALARM_ERROR_NONE)
+	{
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to schedule the planner wake: %d", ret);
+		return ret;
+	}
+
+	preference_set_int(planner_wake_alarm_key, alarm_id);
+	dlog_print(DLOG_INFO, LOG_TAG, "Planner wakes at: %s ", asctime(&date));
+
+	return TIZEN_ERROR_NONE;
+}
+
+/** Loads the registered alarms into the schedule store. The planner wake is not a reminder, so it is left out. */
+int load_schedule()
+{
+	int ret = schedule_store_load_registered();
+	if (ret != TIZEN_ERROR_NONE)
+	{
+		return ret;
+	}
+
+	int wake_alarm_id = get_planner_wake_alarm_id();
+	if (wake_alarm_id >= 0)
+	{
+		schedule_store_remove(wake_alarm_id);
+	}
+
+	// Read while loading, so ringing a reminder does not read the preferences
+	get_plan_generation();
+	return TIZEN_ERROR_NONE;
+}
+
+/** Adds missed reminders to the history: a running total and the count of the last day with misses */
+static void record_missed(int64_t day, int missed)
+{
+	double last_day = 0;
+	int total = 0;
+	int day_count = 0;
+
+	preference_get_int(missed_total_key, &total);
+	if (preference_get_double(missed_last_day_key, &last_day) == PREFERENCE_ERROR_NONE &&
+		(int64_t) last_day == day)
+	{
+		preference_get_int(missed_last_day_count_key, &day_count);
+	}
+
+	preference_set_int(missed_total_key, total + missed);
+	preference_set_double(missed_last_day_key, (double) day);
+	preference_set_int(missed_last_day_count_key, day_count + missed);
+}
+
+/**
+ * Catches up on the reminders that should have gone off while the device was off or the application was not
+ * delivered to. The pending reminders before now are found with a binary search in the schedule store,
+ * marked missed, recorded in the history and cancelled, so the alarm service does not deliver them
+ * one after another. The caller shows at most one reminder for all of them.
+ * Only the reminders of the planner are caught up, the alarms the user set keep their state and their switch.
+ * Returns the number of missed reminders, latest is set to the time of the latest one.
+ */
+int catch_up_missed(int64_t now, int64_t* latest)
+{
+	int end = schedule_store_lower_bound(now - catch_up_grace_seconds);
+	int missed = 0;
+	int i = 0;
+
+	if (latest)
+	{
+		*latest = 0;
+	}
+
+	/*
+	 * Iterate backwards, so the latest missed reminder is the first one found.
+	 */
+	for (i = end - 1; i >= 0; i--)
+	{
+		// The alarms the user set are shown by the list and its switches, they are left to the alarm service
+		if (schedule_store_get_origin(i) != SCHEDULE_ORIGIN_PLANNER ||
+			schedule_store_get_state(i) != SCHEDULE_STATE_PENDING)
+		{
+			continue;
+		}
+
+		if (latest && missed == 0)
+		{
+			*latest = schedule_store_get_epoch(i);
+		}
+
+		alarm_cancel(schedule_store_get_alarm_id(i));
+		schedule_store_set_state(schedule_store_get_alarm_id(i), SCHEDULE_STATE_MISSED);
+		history_append(schedule_store_get_epoch(i), HISTORY_EVENT_MISSED, schedule_store_get_origin(i), 0);
+		note_day_used(schedule_store_get_epoch(i));
+		missed++;
+	}
+
+	if (missed > 0)
+	{
+		record_missed(schedule_day_start(now), missed);
+		dlog_print(DLOG_INFO, LOG_TAG, "Caught up on %d missed reminders", missed);
+	}
+
+	return missed;
+}
+
+/**
+ * The offset of local standard time from UTC in the year of the given time, in seconds. Daylight saving time does not change it.
+ * The shift of daylight saving time differs between time zones, so the offset is read from a date of the year without it:
+ * January or July, whichever is not in daylight saving time.
+ */
+static int get_standard_offset(time_t time)
+{
+	struct tm local;
+	localtime_r(&time, &local);
+	if (local.tm_isdst <= 0)
+	{
+		return (int) local.tm_gmtoff;
+	}
+
+	const int months[] = { 0, 6 };
+	for (int i = 0; i < 2; i++)
+	{
+		struct tm probe = { 0 };
+		probe.tm_year = local.tm_year;
+		probe.tm_mon = months[i];
+		probe.tm_mday = 1;
+		probe.tm_hour = 12;
+		probe.tm_isdst = -1;
+		time_t probe_time = mktime(&probe);
+		localtime_r(&probe_time, &probe);
+		if (probe.tm_isdst == 0)
+		{
+			return (int) probe.tm_gmtoff;
+		}
+	}
+
+	// Daylight saving time all year round is the standard time of the zone
+	return (int) local.tm_gmtoff;
+}
+
+/**
+ * Gets the local date and time of day a time had in the time zone with the given standard offset.
+ * The old time zone is assumed to observe daylight saving time like the current one.
+ */
+static void get_day_at_offset(int64_t epoch, int standard_offset, int* day_key, int64_t* time_of_day)
+{
+	time_t time = (time_t) epoch;
+	struct tm date;
+	localtime_r(&time, &date);
+	// The shift of daylight saving time at that time, in the current time zone
+	time += standard_offset + ((int) date.tm_gmtoff - get_standard_offset(time));
+	gmtime_r(&time, &date);
+
+	*day_key = (date.tm_year + 1900) * 10000 + (date.tm_mon + 1) * 100 + date.tm_mday;
+	*time_of_day = date.tm_hour * 60 * 60 + date.tm_min * 60 + date.tm_sec;
+}
+
+/**
+ * Moves the pending reminders that ended up on another local day back to their local date and time.
+ * The old local days come from the day cache, which still has the old time zone while the application runs,
+ * or from the standard offset that was stored, if the time zone changed while the application was not running.
+ * Returns the number of reminders registered again.
+ */
+static int move_to_local_days(app_control_h app_control, int64_t now_epoch, bool from_offset, int old_offset)
+{
+	preference_set_int(standard_offset_key, get_standard_offset((time_t) now_epoch));
+
+	// The days are looked up in the cache of the old time zone before it is rebuilt
+	int count = schedule_store_count();
+	int ids[count + 1];
+	int old_keys[count + 1];
+	int64_t epochs[count + 1];
+	int64_t offsets[count + 1];
+	int num_pending = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		int64_t epoch = schedule_store_get_epoch(i);
+		if (schedule_store_get_origin(i) != SCHEDULE_ORIGIN_PLANNER ||
+			schedule_store_get_state(i) != SCHEDULE_STATE_PENDING ||
+			epoch <= now_epoch)
+		{
+			continue;
+		}
+
+		ids[num_pending] = schedule_store_get_alarm_id(i);
+		epochs[num_pending] = epoch;
+		if (from_offset)
+		{
+			get_day_at_offset(epoch, old_offset, &old_keys[num_pending], &offsets[num_pending]);
+		} else
+		{
+			old_keys[num_pending] = schedule_day_key(epoch);
+			offsets[num_pending] = epoch - schedule_day_start(epoch);
+		}
+		num_pending++;
+	}
+
+	schedule_day_cache_rebuild(now_epoch);
+
+	int moved = 0;
+	for (int i = 0; i < num_pending; i++)
+	{
+		if (schedule_day_key(epochs[i]) == old_keys[i])
+		{
+			continue;
+		}
+
+		// Same local date and time of day as before, in the new time zone
+		struct tm date = { 0 };
+		date.tm_year = old_keys[i] / 10000 - 1900;
+		date.tm_mon = old_keys[i] / 100 % 100 - 1;
+		date.tm_mday = old_keys[i] % 100;
+		date.tm_isdst = -1;
+		time_t when = mktime(&date) + (time_t) offsets[i];
+
+		cancel_alarm(ids[i]);
+		if (when > (time_t) now_epoch)
+		{
+			schedule_alarms(app_control, -1, 1, &when);
+			moved++;
+		}
+	}
+
+	return moved;
+}
+
+/**
+ * Function for updating all alarms. Plans the days of the horizon that have not been planned yet in one batch,
+ * then makes sure the planner is woken at the next day boundary to plan the day that enters the horizon.
+ * When everything is planned, this costs a few preference reads.
+ */
+int update_alarms(app_control_h app_control)
+{
+	struct tm now;
+	alarm_get_current_time(&now);
+
+	// Nothing is notified of a time zone change while the application is not running, so the planner checks on every run
+	int saved_offset = 0;
+	int offset = get_standard_offset(mktime(&now));
+	if (preference_get_int(standard_offset_key, &saved_offset) != PREFERENCE_ERROR_NONE)
+	{
+		preference_set_int(standard_offset_key, offset);
+	} else if (saved_offset != offset)
+	{
+		int moved = move_to_local_days(app_control, (int64_t) mktime(&now), true, saved_offset);
+		int replanned = replan_alarms(app_control);
+		dlog_print(DLOG_INFO, LOG_TAG, "Time zone changed while closed: %d reminders moved to their local day, %d alarm service calls to plan again.", moved, replanned);
+	}
+
+	int64_t today = schedule_day_start((int64_t) mktime(&now));
+	int64_t tomorrow = schedule_day_next(today);
+	invalidate_week_plan();
+
+	int64_t horizon_end = today;
+	int horizon = get_planning_horizon();
+	for (int i = 0; i < horizon; i++)
+	{
+		horizon_end = schedule_day_next(horizon_end);
+	}
+
+	int64_t day = get_planned_until();
+	if (day == 0)
+	{
+		// Nothing has been planned, reminders of an earlier plan belong to another generation
+		start_plan_generation((int64_t) mktime(&now));
+	}
+	if (day < today)
+	{
+		day = today;
+	}
+
+	if (day < horizon_end)
+	{
+		dlog_print(DLOG_INFO, LOG_TAG, "Updating alarms.");
+	}
+
+	for (; day < horizon_end; day = schedule_day_next(day))
+	{
+		char day_name[16];
+		get_day_name(day, day_name, sizeof(day_name));
+		plan_day(app_control, day, (int64_t) mktime(&now), day_name);
+	}
+
+	preference_set_double(planned_until_key, (double) horizon_end);
+
+	return arm_planner_wake(tomorrow);
+}
+
+/**
+ * Plans the rest of today and the planned days of the horizon again, after the settings have changed.
+ * Only reminders that do not fit the new settings are cancelled, and only the missing ones are added.
+ * A new plan generation is started, the reminders that are kept carry an older one and ring because the store still has them.
+ * Returns the number of calls to the alarm service.
+ */
+int replan_alarms(app_control_h app_control)
+{
+	struct tm now;
+	alarm_get_current_time(&now);
+	int64_t now_epoch = (int64_t) mktime(&now);
+	int64_t planned_until = get_planned_until();
+	int calls = 0;
+	invalidate_week_plan();
+
+	// The reminders added from now on belong to the new plan, the ones kept stay in the schedule store
+	start_plan_generation(now_epoch);
+
+	for (int64_t day = schedule_day_start(now_epoch); day < planned_until; day = schedule_day_next(day))
+	{
+		char day_name[16];
+		get_day_name(day, day_name, sizeof(day_name));
+		calls += plan_day(app_control, day, now_epoch, day_name);
+	}
+
+	dlog_print(DLOG_INFO, LOG_TAG, "Planned again with %d alarm service calls.", calls);
+
+	return calls;
+}
+
+/**
+ * Handles a change of the clock or the time zone.
+ * Reminders keep their absolute time at the alarm service, so after a time zone change they can end up on another local day.
+ * Only those are moved back to their local date and time, then reminders outside the window are planned again,
+ * and the horizon and the planner wake are brought up to date.
+ * Returns the number of reminders registered again.
+ */
+int handle_clock_change(app_control_h app_control)
+{
+	// The local time is read in the new time zone, mktime() would use it anyway
+	tzset();
+	struct tm now;
+	alarm_get_current_time(&now);
+
+	int moved = move_to_local_days(app_control, (int64_t) mktime(&now), false, 0);
+	int replanned = replan_alarms(app_control);
+	update_alarms(app_control);
+
+	dlog_print(DLOG_INFO, LOG_TAG, "Clock changed: %d reminders moved to their local day, %d alarm service calls to plan again.", moved, replanned);
+
+	return moved + replanned;
+}
+
+/** Gets the settings of the planner. Only hours and minutes of the times are used. */
+void get_reminder_settings(int* num_reminders, struct tm* start, struct tm* end)
+{
+	get_target_num_reminders(num_reminders);
+	get_start_time(start);
+	get_stop_time(end);
+}
+
+/** Stores the settings of the planner and plans again if they have changed. Only hours and minutes of the times are used. */
+int set_reminder_settings(app_control_h app_control, int num_reminders, const struct tm* start, const struct tm* end)
+{
+	int old_num_reminders;
+	struct tm old_start;
+	struct tm old_end;
+	get_reminder_settings(&old_num_reminders, &old_start, &old_end);
+
+	if (old_num_reminders == num_reminders &&
+		old_start.tm_hour == start->tm_hour && old_start.tm_min == start->tm_min &&
+		old_end.tm_hour == end->tm_hour && old_end.tm_min == end->tm_min)
+	{
+		return 0;
+	}
+
+	preference_set_int(num_reminders_key, num_reminders);
+	preference_set_int(start_time_hours_key, start->tm_hour);
+	preference_set_int(start_time_mins_key, start->tm_min);
+	preference_set_int(end_time_hours_key, end->tm_hour);
+	preference_set_int(end_time_mins_key, end->tm_min);
+
+	return replan_alarms(app_control);
+}
+
+
+/** Reads the streak of days with at least one dismissed reality check, and the last of these days */
+static void get_streak_data(int* streak, int64_t* last_day)
+{
+	double last_day_value = 0;
+
+	*streak = 0;
+	*last_day = 0;
+
+	// The day is stored as double, preferences have no 64 bit integers
+	if (preference_get_int(streak_days_key, streak) != PREFERENCE_ERROR_NONE ||
+		preference_get_double(streak_last_day_key, &last_day_value) != PREFERENCE_ERROR_NONE)
+	{
+		*streak = 0;
+		return;
+	}
+
+	*last_day = (int64_t) last_day_value;
+}
+
+/** Gets the number of days in a row up to today or yesterday on which a reality check was done */
+int get_streak(int64_t now)
+{
+	int streak;
+	int64_t last_day;
+	get_streak_data(&streak, &last_day);
+
+	int64_t today = schedule_day_start(now);
+	if (last_day == today || schedule_day_next(last_day) == today)
+	{
+		return streak;
+	}
+
+	// The streak has been broken
+	return 0;
+}
+
+/**
+ * Sets the number of reminders per week, 0 to set the number per day. Plans again if it has changed.
+ * Returns the number of calls to the alarm service.
+ */
+int set_weekly_quota(app_control_h app_control, int quota)
+{
+	if (quota < 0 || quota == get_weekly_quota())
+	{
+		return 0;
+	}
+
+	preference_set_int(weekly_quota_key, quota);
+
+	return replan_alarms(app_control);
+}
+
+/** Turns adaptive sampling on or off. It applies to the reminders planned from now on. */
+void set_adaptive_sampling(bool adaptive)
+{
+	preference_set_boolean(adaptive_sampling_key, adaptive);
+}
+
+/** Whether adaptive sampling is on */
+bool is_adaptive_sampling()
+{
+	return get_adaptive_sampling();
+}
+
+/** Records that a reality check was done, extending the streak if it is the first one today */
+void mark_reality_check_done(int64_t now)
+{
+	int streak;
+	int64_t last_day;
+	get_streak_data(&streak, &last_day);
+
+	int64_t today = schedule_day_start(now);
+	if (last_day == today)
+	{
+		// Already counted today
+		return;
+	}
+
+	if (schedule_day_next(last_day) == today)
+	{
+		streak += 1;
+	} else
+	{
+		streak = 1;
+	}
+
+	preference_set_int(streak_days_key, streak);
+	preference_set_double(streak_last_day_key, (double) today);
+	dlog_print(DLOG_INFO, LOG_TAG, "Reality check done, streak is %d days.", streak);
+}
+
+ void test()
+{
+	/* struct tm today;
+	alarm_get_current_time(&today);
+	int num_times = 0;
+	get_target_num_reminders(&num_times);
+	struct tm* result;
+	generate_times(today, num_times, &result);
+
+	struct tm* current = result;
+	for (int i = 0; i < num_times; i++)
+	{
+		int hours = current->tm_hour;
+		int minutes = current->tm_min;
+		current++;
+	}
+
+	free(result); */
+}
+
+
@@ -0,0 +1,605 @@
+/*
+ * schedule.c
+ *
+ * Sorted store of the scheduled reminders.
+ *
+ * The reminders are kept as a structure of arrays sorted by their epoch time,
+ * so the questions the planner, the widget and the UI ask ("what is next?",
+ * "how many on this day?") are binary searches instead of scans over struct tm.
+ * The local day boundaries are cached as well, and rebuilt when the time zone changes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <tizen_error.h>
+#include <app_alarm.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "schedule.h"
+#include "payload.h"
+#include "alloc-debug.h"
+
+#define SCHEDULE_INITIAL_CAPACITY 32
+
+/*
+ * Days in the day-boundary cache, starting yesterday. It covers the planning horizon.
+ */
+#define SCHEDULE_DAY_CACHE_SIZE 16
+
+static struct schedule_info {
+	int64_t *epochs;
+	int *alarm_ids;
+	unsigned char *states;
+	unsigned char *origins;
+	int count;
+	int capacity;
+	unsigned int generation;
+	int64_t day_starts[SCHEDULE_DAY_CACHE_SIZE + 1];
+	int day_keys[SCHEDULE_DAY_CACHE_SIZE];
+	int day_count;
+} s_info = {
+	.epochs = NULL,
+	.alarm_ids = NULL,
+	.states = NULL,
+	.origins = NULL,
+	.count = 0,
+	.capacity = 0,
+	.generation = 0,
+	.day_count = 0,
+};
+
+static int _reserve(int capacity);
+static int _lower_bound(int64_t epoch);
+static void _remove_at(int index);
+static bool _load_registered_alarm_cb(int alarm_id, void *user_data);
+static int _day_cache_index(int64_t epoch);
+static int64_t _compute_day_start(int64_t epoch);
+static int64_t _compute_day_next(int64_t day);
+static int _compute_day_key(int64_t epoch);
+
+/*
+ * @brief Initializes the schedule store.
+ */
+int schedule_store_initialize(void)
+{
+	s_info.count = 0;
+	schedule_day_cache_rebuild((int64_t) time(NULL));
+
+	return _reserve(SCHEDULE_INITIAL_CAPACITY);
+}
+
+/*
+ * @brief Frees the schedule store.
+ */
+void schedule_store_finalize(void)
+{
+	free(s_info.epochs);
+	free(s_info.alarm_ids);
+	free(s_info.states);
+	free(s_info.origins);
+
+	s_info.epochs = NULL;
+	s_info.alarm_ids = NULL;
+	s_info.states = NULL;
+	s_info.origins = NULL;
+	s_info.count = 0;
+	s_info.capacity = 0;
+}
+
+/*
+ * @brief Fills the store with the alarms registered at the alarm service.
+ * The origin of these alarms is unknown, they are stored as scheduled by the planner.
+ */
+int schedule_store_load_registered(void)
+{
+	int ret = 0;
+
+	s_info.count = 0;
+	s_info.generation++;
+
+	ret = alarm_foreach_registered_alarm(_load_registered_alarm_cb, NULL);
+	if (ret != ALARM_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Listing Error: %d ", ret);
+		return ret;
+	}
+
+	dlog_print(DLOG_INFO, LOG_TAG, "Loaded %d scheduled alarms.", s_info.count);
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Adds a reminder, keeping the store sorted by time.
+ * @param[in] epoch Time of the reminder in seconds since the epoch
+ * @param[in] alarm_id ID of the alarm registered at the alarm service
+ * @param[in] state State of the reminder
+ * @param[in] origin Who scheduled the reminder
+ */
+int schedule_store_add(int64_t epoch, int alarm_id, enum schedule_state state, enum schedule_origin origin)
+{
+	int index = 0;
+	int tail = 0;
+	int ret = 0;
+
+	if (s_info.count == s_info.capacity) {
+		ret = _reserve(s_info.capacity ? s_info.capacity * 2 : SCHEDULE_INITIAL_CAPACITY);
+		if (ret != TIZEN_ERROR_NONE) {
+			return ret;
+		}
+	}
+
+	/*
+	 * Insert after the reminders at the same time, so they keep the order they were added in.
+	 */
+	index = _lower_bound(epoch + 1);
+	tail = s_info.count - index;
+
+	memmove(&s_info.epochs[index + 1], &s_info.epochs[index], tail * sizeof(s_info.epochs[0]));
+	memmove(&s_info.alarm_ids[index + 1], &s_info.alarm_ids[index], tail * sizeof(s_info.alarm_ids[0]));
+	memmove(&s_info.states[index + 1], &s_info.states[index], tail * sizeof(s_info.states[0]));
+	memmove(&s_info.origins[index + 1], &s_info.origins[index], tail * sizeof(s_info.origins[0]));
+
+	s_info.epochs[index] = epoch;
+	s_info.alarm_ids[index] = alarm_id;
+	s_info.states[index] = state;
+	s_info.origins[index] = origin;
+	s_info.count++;
+	s_info.generation++;
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Removes the reminder with the given alarm ID.
+ * @param[in] alarm_id ID of the alarm registered at the alarm service
+ */
+int schedule_store_remove(int alarm_id)
+{
+	int index = schedule_store_find(alarm_id);
+
+	if (index < 0) {
+		return TIZEN_ERROR_NO_DATA;
+	}
+
+	_remove_at(index);
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Sets the state of the reminder with the given alarm ID.
+ * @param[in] alarm_id ID of the alarm registered at the alarm service
+ * @param[in] state New state of the reminder
+ */
+int schedule_store_set_state(int alarm_id, enum schedule_state state)
+{
+	int index = schedule_store_find(alarm_id);
+
+	if (index < 0) {
+		return TIZEN_ERROR_NO_DATA;
+	}
+
+	if (s_info.states[index] != state) {
+		s_info.states[index] = state;
+		s_info.generation++;
+	}
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Finds the index of the reminder with the given alarm ID.
+ * The store is sorted by time, not by ID, so this is a scan over the compact ID array.
+ * @param[in] alarm_id ID of the alarm registered at the alarm service
+ * @return The index, or -1 if there is no such reminder
+ */
+int schedule_store_find(int alarm_id)
+{
+	int i;
+
+	for (i = 0; i < s_info.count; i++) {
+		if (s_info.alarm_ids[i] == alarm_id) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * @brief Gets the number of reminders in the store.
+ */
+int schedule_store_count(void)
+{
+	return s_info.count;
+}
+
+/*
+ * @brief Gets the generation of the store, it changes whenever a reminder is added, removed or changes its state.
+ */
+unsigned int schedule_store_get_generation(void)
+{
+	return s_info.generation;
+}
+
+/*
+ * @brief Gets the time of the reminder at the given index.
+ */
+int64_t schedule_store_get_epoch(int index)
+{
+	if (index < 0 || index >= s_info.count) {
+		return -1;
+	}
+
+	return s_info.epochs[index];
+}
+
+/*
+ * @brief Gets the alarm ID of the reminder at the given index.
+ */
+int schedule_store_get_alarm_id(int index)
+{
+	if (index < 0 || index >= s_info.count) {
+		return -1;
+	}
+
+	return s_info.alarm_ids[index];
+}
+
+/*
+ * @brief Gets the state of the reminder at the given index.
+ */
+enum schedule_state schedule_store_get_state(int index)
+{
+	if (index < 0 || index >= s_info.count) {
+		return SCHEDULE_STATE_OFF;
+	}
+
+	return s_info.states[index];
+}
+
+/*
+ * @brief Gets the origin of the reminder at the given index.
+ */
+enum schedule_origin schedule_store_get_origin(int index)
+{
+	if (index < 0 || index >= s_info.count) {
+		return SCHEDULE_ORIGIN_PLANNER;
+	}
+
+	return s_info.origins[index];
+}
+
+/*
+ * @brief Finds the first reminder at or after the given time, in any state.
+ * @param[in] epoch Time in seconds since the epoch
+ * @return The index, equal to the number of reminders if all reminders are earlier
+ */
+int schedule_store_lower_bound(int64_t epoch)
+{
+	return _lower_bound(epoch);
+}
+
+/*
+ * @brief Finds the first pending reminder after the given time.
+ * @param[in] now Time in seconds since the epoch
+ * @return The index, or -1 if there is no pending reminder
+ */
+int schedule_store_next_after(int64_t now)
+{
+	int index = _lower_bound(now + 1);
+
+	while (index < s_info.count && s_info.states[index] != SCHEDULE_STATE_PENDING) {
+		index++;
+	}
+
+	return index < s_info.count ? index : -1;
+}
+
+/*
+ * @brief Counts the reminders on a day, in any state.
+ * @param[in] day Any time on the day in seconds since the epoch
+ */
+int schedule_store_count_in_day(int64_t day)
+{
+	return schedule_store_range(day, day, NULL);
+}
+
+/*
+ * @brief Finds the reminders from the start of one day to the end of another day.
+ * @param[in] day_from Any time on the first day in seconds since the epoch
+ * @param[in] day_to Any time on the last day in seconds since the epoch
+ * @param[out] first The index of the first reminder in the range, can be NULL
+ * @return The number of reminders in the range
+ */
+int schedule_store_range(int64_t day_from, int64_t day_to, int *first)
+{
+	int begin = _lower_bound(schedule_day_start(day_from));
+	int end = _lower_bound(schedule_day_next(schedule_day_start(day_to)));
+
+	if (first) {
+		*first = begin;
+	}
+
+	return end > begin ? end - begin : 0;
+}
+
+/*
+ * @brief Counts the reminders after one time and before another, in any state.
+ * @param[in] from Time in seconds since the epoch, reminders at this time are not counted
+ * @param[in] to Time in seconds since the epoch, reminders at this time are not counted
+ */
+int schedule_store_count_between(int64_t from, int64_t to)
+{
+	int begin = _lower_bound(from + 1);
+	int end = _lower_bound(to);
+
+	return end > begin ? end - begin : 0;
+}
+
+/*
+ * @brief Gets the local midnight of the day.
+ * @param[in] epoch Any time on the day in seconds since the epoch
+ */
+int64_t schedule_day_start(int64_t epoch)
+{
+	int index = _day_cache_index(epoch);
+
+	if (index >= 0) {
+		return s_info.day_starts[index];
+	}
+
+	return _compute_day_start(epoch);
+}
+
+/*
+ * @brief Gets the local midnight of the following day.
+ * Days are not always 24 hours long when DST changes, so the date is advanced instead of the seconds.
+ * @param[in] day The local midnight of a day
+ */
+int64_t schedule_day_next(int64_t day)
+{
+	int index = _day_cache_index(day);
+
+	if (index >= 0 && s_info.day_starts[index] == day) {
+		return s_info.day_starts[index + 1];
+	}
+
+	return _compute_day_next(day);
+}
+
+/*
+ * @brief Gets the local date of a time as a number, e.g. 20180107.
+ * @param[in] epoch Any time on the day in seconds since the epoch
+ */
+int schedule_day_key(int64_t epoch)
+{
+	int index = _day_cache_index(epoch);
+
+	if (index >= 0) {
+		return s_info.day_keys[index];
+	}
+
+	return _compute_day_key(epoch);
+}
+
+/*
+ * @brief Rebuilds the day-boundary cache, e.g. after the time zone has changed.
+ * Until then, the day functions answer from the cache with the boundaries of the time zone it was built in.
+ * @param[in] now Current time in seconds since the epoch
+ */
+void schedule_day_cache_rebuild(int64_t now)
+{
+	int64_t day = 0;
+	int i;
+
+	s_info.day_count = 0;
+
+	tzset();
+
+	day = _compute_day_start(now);
+	day = _compute_day_start(day - 1);
+
+	for (i = 0; i < SCHEDULE_DAY_CACHE_SIZE; i++) {
+		s_info.day_starts[i] = day;
+		s_info.day_keys[i] = _compute_day_key(day);
+		day = _compute_day_next(day);
+	}
+	s_info.day_starts[SCHEDULE_DAY_CACHE_SIZE] = day;
+
+	s_info.day_count = SCHEDULE_DAY_CACHE_SIZE;
+}
+
+/*
+ * @note
+ * Below functions are static functions.
+ */
+
+/*
+ * @brief Grows the arrays of the store to hold at least the given number of reminders.
+ * @param[in] capacity The number of reminders
+ */
+static int _reserve(int capacity)
+{
+	int64_t *epochs = NULL;
+	int *alarm_ids = NULL;
+	unsigned char *states = NULL;
+	unsigned char *origins = NULL;
+
+	if (capacity <= s_info.capacity) {
+		return TIZEN_ERROR_NONE;
+	}
+
+	/*
+	 * Arrays are assigned one by one, so a failure leaves the store consistent with the old capacity.
+	 */
+	epochs = realloc(s_info.epochs, capacity * sizeof(*epochs));
+	if (epochs == NULL) {
+		goto error;
+	}
+	s_info.epochs = epochs;
+
+	alarm_ids = realloc(s_info.alarm_ids, capacity * sizeof(*alarm_ids));
+	if (alarm_ids == NULL) {
+		goto error;
+	}
+	s_info.alarm_ids = alarm_ids;
+
+	states = realloc(s_info.states, capacity * sizeof(*states));
+	if (states == NULL) {
+		goto error;
+	}
+	s_info.states = states;
+
+	origins = realloc(s_info.origins, capacity * sizeof(*origins));
+	if (origins == NULL) {
+		goto error;
+	}
+	s_info.origins = origins;
+
+	s_info.capacity = capacity;
+
+	return TIZEN_ERROR_NONE;
+
+error:
+	dlog_print(DLOG_ERROR, LOG_TAG, "Failed to grow the schedule store to %d reminders.", capacity);
+	return TIZEN_ERROR_OUT_OF_MEMORY;
+}
+
+/*
+ * @brief Finds the first reminder at or after the given time.
+ * @param[in] epoch Time in seconds since the epoch
+ * @return The index, or the number of reminders if all are earlier
+ */
+static int _lower_bound(int64_t epoch)
+{
+	int low = 0;
+	int high = s_info.count;
+
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+
+		if (s_info.epochs[mid] < epoch) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/*
+ * @brief Removes the reminder at the given index.
+ */
+static void _remove_at(int index)
+{
+	int tail = s_info.count - index - 1;
+
+	memmove(&s_info.epochs[index], &s_info.epochs[index + 1], tail * sizeof(s_info.epochs[0]));
+	memmove(&s_info.alarm_ids[index], &s_info.alarm_ids[index + 1], tail * sizeof(s_info.alarm_ids[0]));
+	memmove(&s_info.states[index], &s_info.states[index + 1], tail * sizeof(s_info.states[0]));
+	memmove(&s_info.origins[index], &s_info.origins[index + 1], tail * sizeof(s_info.origins[0]));
+
+	s_info.count--;
+	s_info.generation++;
+}
+
+/*
+ * @brief Adds a registered alarm to the store. Its origin is taken from the payload it carries;
+ * alarms registered before payloads existed were all set by the planner.
+ */
+static bool _load_registered_alarm_cb(int alarm_id, void *user_data)
+{
+	struct tm date;
+	app_control_h app_control = NULL;
+	struct alarm_payload payload;
+	enum schedule_origin origin = SCHEDULE_ORIGIN_PLANNER;
+	int ret = 0;
+
+	ret = alarm_get_scheduled_date(alarm_id, &date);
+	if (ret != ALARM_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Get time Error: %d ", ret);
+		return true;
+	}
+
+	if (alarm_get_app_control(alarm_id, &app_control) == ALARM_ERROR_NONE) {
+		if (alarm_payload_read(app_control, &payload) == TIZEN_ERROR_NONE) {
+			origin = payload.kind;
+		}
+		app_control_destroy(app_control);
+	}
+
+	schedule_store_add((int64_t) mktime(&date), alarm_id, SCHEDULE_STATE_PENDING, origin);
+
+	return true;
+}
+
+/*
+ * @brief Finds the day of a time in the day-boundary cache.
+ * @return The index of the day, or -1 if the time is not covered
+ */
+static int _day_cache_index(int64_t epoch)
+{
+	int low = 0;
+	int high = s_info.day_count;
+	int mid = 0;
+
+	if (s_info.day_count == 0 || epoch < s_info.day_starts[0] || epoch >= s_info.day_starts[s_info.day_count]) {
+		return -1;
+	}
+
+	while (high - low > 1) {
+		mid = (low + high) / 2;
+		if (s_info.day_starts[mid] <= epoch) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static int64_t _compute_day_start(int64_t epoch)
+{
+	time_t t = (time_t) epoch;
+	struct tm date;
+
+	localtime_r(&t, &date);
+	date.tm_hour = 0;
+	date.tm_min = 0;
+	date.tm_sec = 0;
+	date.tm_isdst = -1;
+
+	return (int64_t) mktime(&date);
+}
+
+static int64_t _compute_day_next(int64_t day)
+{
+	time_t t = (time_t) day;
+	struct tm date;
+
+	localtime_r(&t, &date);
+	date.tm_mday += 1;
+	date.tm_hour = 0;
+	date.tm_min = 0;
+	date.tm_sec = 0;
+	date.tm_isdst = -1;
+
+	return (int64_t) mktime(&date);
+}
+
+static int _compute_day_key(int64_t epoch)
+{
+	time_t t = (time_t) epoch;
+	struct tm date;
+
+	localtime_r(&t, &date);
+
+	return (date.tm_year + 1900) * 10000 + (date.tm_mon + 1) * 100 + date.tm_mday;
+}
+
+/* End of file */
@@ -0,0 +1,378 @@
+/*
+ * state.c
+ *
+ * On/off state of the alarms shared with the widget.
+ *
+ * The state of all widget alarms is kept in one preference record holding a generation
+ * counter and a bitmap with one bit per slot. Every widget alarm gets a slot when it is
+ * attached, and the widget learns it with the alarm. A toggle on either side is one write
+ * of the record, and a single change callback handles only the bits that differ.
+ * Which alarm holds which slot is kept in a second preference, written only when slots are
+ * taken or freed, so the widgets keep their slots when the application is killed and starts again.
+ * Slots whose alarms are no longer registered are freed when the application starts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <tizen_error.h>
+#include <Elementary.h>
+#include <app.h>
+#include <app_preference.h>
+#include <app_alarm.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "data.h"
+#include "state.h"
+
+#define STATE_RECORD_KEY "alarm_state"
+#define STATE_RECORD_LEN 32
+#define STATE_SLOTS_KEY "alarm_state_slots"
+#define STATE_SLOTS_LEN (STATE_MAX_SLOTS * 16)
+
+static struct state_info {
+	uint64_t bitmap;
+	uint64_t used;
+	unsigned int generation;
+	struct genlist_item_data *slots[STATE_MAX_SLOTS];
+	int alarm_ids[STATE_MAX_SLOTS];
+	state_changed_cb changed_cb;
+	Eina_Bool initialized;
+} s_info = {
+	.bitmap = 0,
+	.used = 0,
+	.generation = 0,
+	.slots = { NULL, },
+	.alarm_ids = { 0, },
+	.changed_cb = NULL,
+	.initialized = EINA_FALSE,
+};
+
+static Eina_Bool _read_record(unsigned int *generation, uint64_t *bitmap);
+static void _write_record(void);
+static void _read_slots(void);
+static void _free_stale_slots(void);
+static void _write_slots(void);
+static void _record_changed_cb(const char *key, void *user_data);
+
+/*
+ * @brief Initializes the state record and starts watching it.
+ * The slots taken in the last run are taken again, with their bits, until their alarms are attached or detached.
+ * Slots of alarms that are no longer registered are freed, nothing would attach them again.
+ * The bits of free slots are cleared. The generation keeps counting.
+ * @param[in] changed_cb The function called for every alarm toggled by the widget
+ */
+int state_record_initialize(state_changed_cb changed_cb)
+{
+	uint64_t bitmap = 0;
+	int ret = 0;
+
+	s_info.changed_cb = changed_cb;
+	s_info.bitmap = 0;
+	s_info.used = 0;
+
+	_read_slots();
+	_free_stale_slots();
+	_read_record(&s_info.generation, &bitmap);
+	s_info.bitmap = bitmap & s_info.used;
+	_write_record();
+	s_info.initialized = EINA_TRUE;
+
+	ret = preference_set_changed_cb(STATE_RECORD_KEY, _record_changed_cb, NULL);
+	if (ret != PREFERENCE_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to set changed cb(%d) : %s", ret, STATE_RECORD_KEY);
+		return TIZEN_ERROR_IO_ERROR;
+	}
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Stops watching the state record.
+ * Alarms detached from now on keep their slots for the next run. On a normal exit the UI is
+ * torn down before, so its alarms have freed their slots already.
+ */
+void state_record_finalize(void)
+{
+	preference_unset_changed_cb(STATE_RECORD_KEY);
+
+	s_info.initialized = EINA_FALSE;
+	s_info.changed_cb = NULL;
+	memset(s_info.slots, 0, sizeof(s_info.slots));
+}
+
+/*
+ * @brief Gives a widget alarm a slot in the state record. An alarm that had a slot in an earlier run gets it back.
+ * @param[in] gendata The alarm
+ * @param[in] on The initial state of the alarm
+ * @return The slot, or -1 if all slots are taken
+ */
+int state_record_attach(struct genlist_item_data *gendata, Eina_Bool on)
+{
+	int slot = 0;
+
+	if (gendata == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "gendata is NULL");
+		return -1;
+	}
+
+	if (gendata->state_slot >= 0) {
+		state_record_set(gendata, on);
+		return gendata->state_slot;
+	}
+
+	for (slot = 0; slot < STATE_MAX_SLOTS; slot++) {
+		if ((s_info.used >> slot & 1) && s_info.slots[slot] == NULL && s_info.alarm_ids[slot] == gendata->alarm_id) {
+			break;
+		}
+	}
+
+	if (slot == STATE_MAX_SLOTS) {
+		if (s_info.used == UINT64_MAX) {
+			dlog_print(DLOG_ERROR, LOG_TAG, "All %d state slots are taken.", STATE_MAX_SLOTS);
+			return -1;
+		}
+
+		slot = __builtin_ctzll(~s_info.used);
+		s_info.used |= UINT64_C(1) << slot;
+		s_info.alarm_ids[slot] = gendata->alarm_id;
+		_write_slots();
+	}
+
+	s_info.slots[slot] = gendata;
+	gendata->state_slot = slot;
+
+	state_record_set(gendata, on);
+
+	return slot;
+}
+
+/*
+ * @brief Frees the slot of an alarm.
+ * The bit is cleared without writing the record, the next write carries it along.
+ * After state_record_finalize() the slot is kept for the next run.
+ * @param[in] gendata The alarm
+ */
+void state_record_detach(struct genlist_item_data *gendata)
+{
+	uint64_t bit = 0;
+
+	if (gendata == NULL || gendata->state_slot < 0) {
+		return;
+	}
+
+	if (s_info.initialized) {
+		bit = UINT64_C(1) << gendata->state_slot;
+		s_info.used &= ~bit;
+		s_info.bitmap &= ~bit;
+		s_info.slots[gendata->state_slot] = NULL;
+		_write_slots();
+	}
+
+	gendata->state_slot = -1;
+}
+
+/*
+ * @brief Sets the state of an alarm in the record. Nothing is written if the state is the same.
+ * An alarm scheduled again has a new ID, the slot follows it.
+ * @param[in] gendata The alarm
+ * @param[in] on The state of the alarm
+ */
+void state_record_set(struct genlist_item_data *gendata, Eina_Bool on)
+{
+	uint64_t bitmap = 0;
+	uint64_t bit = 0;
+
+	if (gendata == NULL || gendata->state_slot < 0) {
+		return;
+	}
+
+	if (s_info.alarm_ids[gendata->state_slot] != gendata->alarm_id) {
+		s_info.alarm_ids[gendata->state_slot] = gendata->alarm_id;
+		_write_slots();
+	}
+
+	bit = UINT64_C(1) << gendata->state_slot;
+	bitmap = on ? (s_info.bitmap | bit) : (s_info.bitmap & ~bit);
+	if (bitmap == s_info.bitmap) {
+		return;
+	}
+
+	s_info.bitmap = bitmap;
+	s_info.generation++;
+	_write_record();
+}
+
+/*
+ * @brief Gets the generation of the state record.
+ */
+unsigned int state_record_get_generation(void)
+{
+	return s_info.generation;
+}
+
+/*
+ * @note
+ * Below functions are static functions.
+ */
+
+/*
+ * @brief Reads the record. It is stored as "<generation>:<bitmap in hex>".
+ */
+static Eina_Bool _read_record(unsigned int *generation, uint64_t *bitmap)
+{
+	char *str = NULL;
+	unsigned long long value = 0;
+	Eina_Bool ret = EINA_FALSE;
+
+	if (preference_get_string(STATE_RECORD_KEY, &str) != PREFERENCE_ERROR_NONE || str == NULL) {
+		return EINA_FALSE;
+	}
+
+	if (sscanf(str, "%u:%llx", generation, &value) == 2) {
+		*bitmap = (uint64_t) value;
+		ret = EINA_TRUE;
+	} else {
+		dlog_print(DLOG_ERROR, LOG_TAG, "State record is broken : %s", str);
+	}
+
+	free(str);
+
+	return ret;
+}
+
+/*
+ * @brief Writes the record with one preference write.
+ */
+static void _write_record(void)
+{
+	char str[STATE_RECORD_LEN] = { 0, };
+
+	snprintf(str, sizeof(str), "%u:%016llx", s_info.generation, (unsigned long long) s_info.bitmap);
+
+	if (preference_set_string(STATE_RECORD_KEY, str) != PREFERENCE_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed at preference_set_string()");
+	}
+}
+
+/*
+ * @brief Reads which alarm holds which slot. It is stored as "<slot>=<alarm ID>" pairs separated by commas.
+ */
+static void _read_slots(void)
+{
+	char *str = NULL;
+	char *pair = NULL;
+	char *save = NULL;
+	int slot = 0;
+	int alarm_id = 0;
+
+	s_info.used = 0;
+
+	if (preference_get_string(STATE_SLOTS_KEY, &str) != PREFERENCE_ERROR_NONE || str == NULL) {
+		return;
+	}
+
+	for (pair = strtok_r(str, ",", &save); pair; pair = strtok_r(NULL, ",", &save)) {
+		if (sscanf(pair, "%d=%d", &slot, &alarm_id) != 2 || slot < 0 || slot >= STATE_MAX_SLOTS) {
+			dlog_print(DLOG_ERROR, LOG_TAG, "State slot is broken : %s", pair);
+			continue;
+		}
+
+		s_info.used |= UINT64_C(1) << slot;
+		s_info.alarm_ids[slot] = alarm_id;
+	}
+
+	free(str);
+}
+
+/*
+ * @brief Frees the slots whose alarms are no longer registered, e.g. when the last run was killed after the alarm went off.
+ */
+static void _free_stale_slots(void)
+{
+	struct tm date;
+	uint64_t used = s_info.used;
+	uint64_t stale = 0;
+	int slot = 0;
+
+	while (used) {
+		slot = __builtin_ctzll(used);
+		used &= used - 1;
+
+		if (alarm_get_scheduled_date(s_info.alarm_ids[slot], &date) != ALARM_ERROR_NONE) {
+			stale |= UINT64_C(1) << slot;
+		}
+	}
+
+	if (stale == 0) {
+		return;
+	}
+
+	dlog_print(DLOG_INFO, LOG_TAG, "Freeing %d state slots of alarms that are gone.", __builtin_popcountll(stale));
+
+	s_info.used &= ~stale;
+	_write_slots();
+}
+
+/*
+ * @brief Writes which alarm holds which slot.
+ */
+static void _write_slots(void)
+{
+	char str[STATE_SLOTS_LEN] = { 0, };
+	uint64_t used = s_info.used;
+	int len = 0;
+	int slot = 0;
+
+	while (used) {
+		slot = __builtin_ctzll(used);
+		used &= used - 1;
+		len += snprintf(str + len, sizeof(str) - len, len ? ",%d=%d" : "%d=%d", slot, s_info.alarm_ids[slot]);
+	}
+
+	if (preference_set_string(STATE_SLOTS_KEY, str) != PREFERENCE_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed at preference_set_string()");
+	}
+}
+
+/*
+ * @brief Handles a change of the record. Only the bits of attached slots that differ are passed on.
+ * A record with the generation this side wrote last is the echo of its own write.
+ */
+static void _record_changed_cb(const char *key, void *user_data)
+{
+	unsigned int generation = 0;
+	uint64_t bitmap = 0;
+	uint64_t changed = 0;
+	struct genlist_item_data *gendata = NULL;
+	int slot = 0;
+
+	if (!_read_record(&generation, &bitmap)) {
+		return;
+	}
+
+	if (generation == s_info.generation) {
+		return;
+	}
+
+	changed = (bitmap ^ s_info.bitmap) & s_info.used;
+
+	s_info.generation = generation;
+	s_info.bitmap = (bitmap & s_info.used);
+
+	dlog_print(DLOG_INFO, LOG_TAG, "State record generation(%u), changed(%016llx)", generation, (unsigned long long) changed);
+
+	while (changed) {
+		slot = __builtin_ctzll(changed);
+		changed &= changed - 1;
+
+		gendata = s_info.slots[slot];
+		if (gendata && s_info.changed_cb) {
+			s_info.changed_cb(gendata, (bitmap >> slot) & 1);
+		}
+	}
+}
+
+/* End of file */
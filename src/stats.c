@@ -0,0 +1,324 @@
+/*
+ * stats.c
+ *
+ * Rollups of the history of the reminders by hour of day and weekday.
+ *
+ * Each hour of each weekday has a cell of counters and a sketch of the response times.
+ * The sketch is a histogram with two buckets per doubling of the response time, the median read from it
+ * is within 19% of the real one. A cell is updated in O(1) for each record appended to the history,
+ * and a summary of any hour, weekday or both is read from at most STATS_WEEKDAYS * STATS_HOURS cells,
+ * whatever the length of the history.
+ *
+ * The cells are saved next to the history each time the history is flushed, together with the size of
+ * the history they cover. More than one process may append to the history; the records
+ * another process appended are read from the end of what the cells cover, at the next flush or refresh. If the sizes do not match when the application starts, like after a crash between
+ * the two writes, the cells are built again from the history.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <tizen_error.h>
+#include <dlog.h>
+
+#include "gear-reality-check.h"
+#include "history.h"
+#include "stats.h"
+#include "alloc-debug.h"
+
+#define STATS_VERSION 1
+#define STATS_SKETCH_BUCKETS 24
+#define STATS_SKETCH_MIN_MS 250.0
+#define STATS_PATH_LEN 1024
+
+struct stats_cell {
+	uint32_t shown;
+	uint32_t dismissed;
+	uint32_t ignored;
+	uint32_t missed;
+	uint64_t response_sum_ms;
+	uint32_t sketch[STATS_SKETCH_BUCKETS];
+};
+
+/*
+ * The saved file is this structure as it is in memory, it is only read back on the same device.
+ */
+struct stats_file {
+	uint32_t version;
+	uint32_t history_size;
+	struct stats_cell cells[STATS_WEEKDAYS][STATS_HOURS];
+};
+
+static struct stats_info {
+	char path[STATS_PATH_LEN];
+	struct stats_file file;
+	unsigned int generation;
+	int initialized;
+} s_info = {
+	.path = { 0, },
+	.file = { 0, },
+	.generation = 0,
+	.initialized = 0,
+};
+
+static bool _add_record_cb(const struct history_record *record, void *data);
+static void _flushed_cb(size_t from, size_t size, void *data);
+static void _save(size_t size);
+static int _sketch_bucket(unsigned int response_ms);
+static unsigned int _sketch_bucket_value(int bucket);
+
+/*
+ * @brief Loads the rollups saved next to the history, or builds them from the history,
+ * then keeps them up to date with the records appended to the history.
+ * The history has to be initialized first.
+ * @param[in] path The path of the file of the rollups
+ * @return TIZEN_ERROR_NONE, or TIZEN_ERROR_INVALID_PARAMETER if the path is too long
+ */
+int stats_initialize(const char *path)
+{
+	FILE *fp = NULL;
+	size_t loaded = 0;
+	size_t history_size = history_get_size();
+
+	if (snprintf(s_info.path, sizeof(s_info.path), "%s", path) >= (int) sizeof(s_info.path)) {
+		return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	fp = fopen(s_info.path, "rb");
+	if (fp) {
+		loaded = fread(&s_info.file, sizeof(s_info.file), 1, fp);
+		fclose(fp);
+	}
+
+	if (loaded != 1 || s_info.file.version != STATS_VERSION || s_info.file.history_size != history_size) {
+		dlog_print(DLOG_INFO, LOG_TAG, "Building the statistics from the history of %zu bytes", history_size);
+		memset(&s_info.file, 0, sizeof(s_info.file));
+		s_info.file.version = STATS_VERSION;
+		history_foreach(_add_record_cb, NULL);
+		_save(history_size);
+	}
+
+	history_set_listener(_add_record_cb, _flushed_cb, NULL);
+	s_info.initialized = 1;
+
+	return TIZEN_ERROR_NONE;
+}
+
+/*
+ * @brief Stops following the history. The rollups were saved with the last flush of the history.
+ */
+void stats_finalize(void)
+{
+	if (!s_info.initialized) {
+		return;
+	}
+
+	history_set_listener(NULL, NULL, NULL);
+	s_info.initialized = 0;
+}
+
+/*
+ * @brief Adds the records the other process has appended to the history since the rollups were last updated.
+ * Call it before reading a set of summaries; it costs a stat of the history file when nothing was appended.
+ */
+void stats_refresh(void)
+{
+	size_t end = 0;
+
+	if (!s_info.initialized) {
+		return;
+	}
+
+	if (history_foreach_range(s_info.file.history_size, SIZE_MAX, _add_record_cb, NULL, &end) > 0) {
+		dlog_print(DLOG_INFO, LOG_TAG, "Added %zu bytes of history from the other process", end - s_info.file.history_size);
+		s_info.file.history_size = (uint32_t) end;
+	}
+}
+
+/*
+ * @brief Summarizes the reminders of an hour of a weekday.
+ * @param[in] weekday The weekday, 0 is Sunday, or STATS_ALL for every weekday
+ * @param[in] hour The hour of day, or STATS_ALL for every hour
+ * @param[out] summary The summary
+ */
+void stats_get(int weekday, int hour, struct stats_summary *summary)
+{
+	uint32_t sketch[STATS_SKETCH_BUCKETS] = { 0, };
+	uint64_t response_sum_ms = 0;
+	uint32_t half = 0;
+	uint32_t count = 0;
+	const struct stats_cell *cell = NULL;
+	int first_weekday = weekday == STATS_ALL ? 0 : weekday;
+	int last_weekday = weekday == STATS_ALL ? STATS_WEEKDAYS - 1 : weekday;
+	int first_hour = hour == STATS_ALL ? 0 : hour;
+	int last_hour = hour == STATS_ALL ? STATS_HOURS - 1 : hour;
+	int d = 0;
+	int h = 0;
+	int i = 0;
+
+	memset(summary, 0, sizeof(*summary));
+
+	if (first_weekday < 0 || last_weekday >= STATS_WEEKDAYS || first_hour < 0 || last_hour >= STATS_HOURS) {
+		return;
+	}
+
+	for (d = first_weekday; d <= last_weekday; d++) {
+		for (h = first_hour; h <= last_hour; h++) {
+			cell = &s_info.file.cells[d][h];
+			summary->shown += cell->shown;
+			summary->dismissed += cell->dismissed;
+			summary->ignored += cell->ignored;
+			summary->missed += cell->missed;
+			response_sum_ms += cell->response_sum_ms;
+			for (i = 0; i < STATS_SKETCH_BUCKETS; i++) {
+				sketch[i] += cell->sketch[i];
+			}
+		}
+	}
+
+	/*
+	 * A missed reminder was due as much as a shown one.
+	 */
+	if (summary->shown + summary->missed > 0) {
+		summary->response_rate_permille = (unsigned int) ((uint64_t) summary->dismissed * 1000 / (summary->shown + summary->missed));
+	}
+
+	if (summary->dismissed == 0) {
+		return;
+	}
+
+	summary->mean_response_ms = (unsigned int) (response_sum_ms / summary->dismissed);
+
+	half = (summary->dismissed + 1) / 2;
+	for (i = 0; i < STATS_SKETCH_BUCKETS; i++) {
+		count += sketch[i];
+		if (count >= half) {
+			summary->median_response_ms = _sketch_bucket_value(i);
+			break;
+		}
+	}
+}
+
+/*
+ * @brief Gets a number that changes whenever the rollups change, so users of the rollups can tell
+ * whether what they derived from them is still current.
+ */
+unsigned int stats_get_generation(void)
+{
+	return s_info.generation;
+}
+
+/*
+ * @note Below functions are static functions.
+ */
+
+/*
+ * @brief Adds a record of the history to the cell of the hour and weekday the reminder was shown at.
+ */
+static bool _add_record_cb(const struct history_record *record, void *data)
+{
+	struct stats_cell *cell = NULL;
+	struct tm date;
+	time_t shown_at = (time_t) (record->time - record->response_ms / 1000);
+
+	localtime_r(&shown_at, &date);
+	cell = &s_info.file.cells[date.tm_wday][date.tm_hour];
+
+	switch (record->event) {
+	case HISTORY_EVENT_SHOWN:
+		cell->shown++;
+		break;
+	case HISTORY_EVENT_DISMISSED:
+		cell->dismissed++;
+		cell->response_sum_ms += record->response_ms;
+		cell->sketch[_sketch_bucket(record->response_ms)]++;
+		break;
+	case HISTORY_EVENT_IGNORED:
+		cell->ignored++;
+		break;
+	case HISTORY_EVENT_MISSED:
+		cell->missed++;
+		break;
+	default:
+		break;
+	}
+
+	s_info.generation++;
+
+	return true;
+}
+
+/*
+ * @brief Takes in the records the other process wrote before the batch that was flushed,
+ * the records of the batch were added as they were appended. Then saves the rollups.
+ */
+static void _flushed_cb(size_t from, size_t size, void *data)
+{
+	size_t end = 0;
+
+	if (from > s_info.file.history_size) {
+		history_foreach_range(s_info.file.history_size, from, _add_record_cb, NULL, &end);
+	}
+
+	_save(size);
+}
+
+/*
+ * @brief Saves the rollups with the size of the history they cover.
+ * The file is replaced in one rename, so a crash leaves the old or the new file.
+ */
+static void _save(size_t size)
+{
+	char tmp_path[STATS_PATH_LEN + 4] = { 0, };
+	FILE *fp = NULL;
+	size_t written = 0;
+
+	s_info.file.history_size = (uint32_t) size;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", s_info.path);
+	fp = fopen(tmp_path, "wb");
+	if (fp == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to save the statistics: %s", strerror(errno));
+		return;
+	}
+
+	written = fwrite(&s_info.file, sizeof(s_info.file), 1, fp);
+	if (fclose(fp) != 0 || written != 1 || rename(tmp_path, s_info.path) != 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to save the statistics: %s", strerror(errno));
+		remove(tmp_path);
+	}
+}
+
+/*
+ * @brief Gets the bucket of the sketch of a response time. Bucket i holds the times from
+ * STATS_SKETCH_MIN_MS * 2^((i - 1) / 2) up to the next bucket, the first one the times below STATS_SKETCH_MIN_MS.
+ */
+static int _sketch_bucket(unsigned int response_ms)
+{
+	int bucket = 0;
+
+	if (response_ms < STATS_SKETCH_MIN_MS) {
+		return 0;
+	}
+
+	bucket = 1 + (int) (2.0 * log2(response_ms / STATS_SKETCH_MIN_MS));
+
+	return bucket < STATS_SKETCH_BUCKETS ? bucket : STATS_SKETCH_BUCKETS - 1;
+}
+
+/*
+ * @brief Gets the response time a bucket of the sketch stands for, the geometric middle of the bucket.
+ */
+static unsigned int _sketch_bucket_value(int bucket)
+{
+	if (bucket == 0) {
+		return (unsigned int) (STATS_SKETCH_MIN_MS / 2);
+	}
+
+	return (unsigned int) (STATS_SKETCH_MIN_MS * pow(2.0, (bucket - 0.5) / 2.0) + 0.5);
+}
+
+/* End of file */
@@ -0,0 +1,381 @@
+/*
+ * timer-wheel.c
+ *
+ * In-app timers on a hierarchical timer wheel.
+ *
+ * All in-app timers share a single Ecore timer. A tick is one frame. The wheel has four levels of 64 slots,
+ * a level holds the timers that expire within 64 times the span of the level below, so a timer is inserted
+ * and cancelled in constant time. Timers move down a level when the slots of the level below come around.
+ * The Ecore timer is set to the next slot that holds timers, at any level, so a long timer costs no wake-ups
+ * before it expires.
+ */
+
+#include <tizen_error.h>
+#include <math.h>
+#include <dlog.h>
+#include <Ecore.h>
+
+#include "gear-reality-check.h"
+#include "timer-wheel.h"
+#include "alloc-debug.h"
+
+#define TIMER_WHEEL_TICK_SECONDS (1.0 / 60.0)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_NONE INT64_MAX
+
+/*
+ * A delay this close to a tick is taken as the tick, a delay computed from a tick must not skip it.
+ */
+#define TIMER_WHEEL_EPSILON 1e-6
+
+static struct timer_wheel_info {
+	struct timer_wheel_entry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	uint64_t occupied[TIMER_WHEEL_LEVELS];
+	struct timer_wheel_entry *groups[TIMER_GROUP_MAX];
+	int64_t current;
+	int64_t armed_tick;
+	int count;
+	double origin;
+	int started;
+	Ecore_Timer *timer;
+} s_info = {
+	.current = 0,
+	.armed_tick = TIMER_WHEEL_NONE,
+	.count = 0,
+	.origin = 0.0,
+	.started = 0,
+	.timer = NULL,
+};
+
+static int64_t _now_tick(void);
+static void _insert(struct timer_wheel_entry *entry);
+static void _unlink(struct timer_wheel_entry *entry);
+static int64_t _next_tick(void);
+static void _expire(int64_t until);
+static void _rearm(void);
+static Eina_Bool _timer_cb(void *data);
+
+/*
+ * @brief Adds a timer. A timer that is pending is moved.
+ * @param[in] entry The timer, owned by the caller until it expires or is cancelled
+ * @param[in] delay Seconds until the timer expires, rounded up to a tick
+ * @param[in] group The group the timer is cancelled with
+ * @param[in] cb The function called when the timer expires
+ * @param[in] data Data passed to cb
+ */
+void timer_wheel_add(struct timer_wheel_entry *entry, double delay, enum timer_group group, timer_wheel_cb cb, void *data)
+{
+	int64_t now = 0;
+
+	if (entry == NULL || cb == NULL || group < 0 || group >= TIMER_GROUP_MAX) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Invalid timer");
+		return;
+	}
+
+	if (timer_wheel_pending(entry)) {
+		_unlink(entry);
+	}
+
+	now = _now_tick();
+
+	/*
+	 * An empty wheel starts over at the current tick, it has nothing to catch up on.
+	 */
+	if (s_info.count == 0) {
+		s_info.current = now;
+	}
+
+	entry->expires = now + (int64_t) ceil((delay > 0.0 ? delay : 0.0) / TIMER_WHEEL_TICK_SECONDS - TIMER_WHEEL_EPSILON);
+	if (entry->expires <= s_info.current) {
+		entry->expires = s_info.current + 1;
+	}
+	entry->group = group;
+	entry->cb = cb;
+	entry->data = data;
+
+	_insert(entry);
+
+	entry->group_next = s_info.groups[group];
+	if (entry->group_next) {
+		entry->group_next->group_pprev = &entry->group_next;
+	}
+	entry->group_pprev = &s_info.groups[group];
+	s_info.groups[group] = entry;
+
+	_rearm();
+}
+
+/*
+ * @brief Cancels a timer. Cancelling a timer that is not pending does nothing.
+ */
+void timer_wheel_cancel(struct timer_wheel_entry *entry)
+{
+	if (entry == NULL || !timer_wheel_pending(entry)) {
+		return;
+	}
+
+	_unlink(entry);
+	_rearm();
+}
+
+/*
+ * @brief Cancels every timer of a group.
+ */
+void timer_wheel_cancel_group(enum timer_group group)
+{
+	if (group < 0 || group >= TIMER_GROUP_MAX) {
+		return;
+	}
+
+	while (s_info.groups[group]) {
+		_unlink(s_info.groups[group]);
+	}
+
+	_rearm();
+}
+
+/*
+ * @brief Checks if a timer is waiting to expire.
+ */
+int timer_wheel_pending(const struct timer_wheel_entry *entry)
+{
+	return entry->pprev != NULL;
+}
+
+/*
+ * @brief Gets the first tick at or after a time. Timers that expire at that time run at that tick.
+ * @param[in] time Monotonic time in seconds
+ */
+double timer_wheel_align(double time)
+{
+	_now_tick();
+
+	return s_info.origin + ceil((time - s_info.origin) / TIMER_WHEEL_TICK_SECONDS - TIMER_WHEEL_EPSILON) * TIMER_WHEEL_TICK_SECONDS;
+}
+
+/*
+ * @brief Cancels every timer and deletes the Ecore timer.
+ */
+void timer_wheel_finalize(void)
+{
+	int group = 0;
+
+	for (group = 0; group < TIMER_GROUP_MAX; group++) {
+		while (s_info.groups[group]) {
+			_unlink(s_info.groups[group]);
+		}
+	}
+
+	_rearm();
+}
+
+/*
+ * @note Below functions are static functions.
+ */
+
+/*
+ * @brief Gets the tick of now. Ticks are counted from the first use of the wheel.
+ */
+static int64_t _now_tick(void)
+{
+	double now = ecore_time_get();
+
+	if (!s_info.started) {
+		s_info.origin = now;
+		s_info.started = 1;
+	}
+
+	return (int64_t) floor((now - s_info.origin) / TIMER_WHEEL_TICK_SECONDS + TIMER_WHEEL_EPSILON);
+}
+
+/*
+ * @brief Puts a timer in the slot of the lowest level whose span covers its delay.
+ * The slot is taken from the bits of the expiry tick, so it does not depend on when the timer was inserted.
+ * Timers beyond the span of the wheel wait in the farthest slot of the top level and are placed again from there.
+ */
+static void _insert(struct timer_wheel_entry *entry)
+{
+	int64_t delta = entry->expires - s_info.current;
+	int64_t expires = entry->expires;
+	int level = 0;
+
+	while (level < TIMER_WHEEL_LEVELS - 1 && delta >= ((int64_t) 1 << (TIMER_WHEEL_BITS * (level + 1)))) {
+		level++;
+	}
+
+	if (delta >= ((int64_t) 1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))) {
+		expires = s_info.current + ((int64_t) TIMER_WHEEL_MASK << (TIMER_WHEEL_BITS * level));
+	}
+
+	entry->level = level;
+	entry->slot = (int) ((expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+
+	entry->next = s_info.slots[level][entry->slot];
+	if (entry->next) {
+		entry->next->pprev = &entry->next;
+	}
+	entry->pprev = &s_info.slots[level][entry->slot];
+	s_info.slots[level][entry->slot] = entry;
+
+	s_info.occupied[level] |= (uint64_t) 1 << entry->slot;
+	s_info.count++;
+}
+
+/*
+ * @brief Takes a timer out of its slot and its group.
+ */
+static void _unlink(struct timer_wheel_entry *entry)
+{
+	*entry->pprev = entry->next;
+	if (entry->next) {
+		entry->next->pprev = entry->pprev;
+	}
+	entry->next = NULL;
+	entry->pprev = NULL;
+
+	if (s_info.slots[entry->level][entry->slot] == NULL) {
+		s_info.occupied[entry->level] &= ~((uint64_t) 1 << entry->slot);
+	}
+
+	*entry->group_pprev = entry->group_next;
+	if (entry->group_next) {
+		entry->group_next->group_pprev = entry->group_pprev;
+	}
+	entry->group_next = NULL;
+	entry->group_pprev = NULL;
+
+	s_info.count--;
+}
+
+/*
+ * @brief Finds the next tick that has work: the expiry of a slot of the bottom level,
+ * or the start of a slot of a higher level, whose timers then move down.
+ */
+static int64_t _next_tick(void)
+{
+	int64_t best = TIMER_WHEEL_NONE;
+	int64_t index = 0;
+	int64_t tick = 0;
+	uint64_t bits = 0;
+	int shift = 0;
+	int start = 0;
+	int level = 0;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		if (s_info.occupied[level] == 0) {
+			continue;
+		}
+
+		/*
+		 * Rotate the slots so that the slot after the current one is bit 0.
+		 */
+		shift = TIMER_WHEEL_BITS * level;
+		index = s_info.current >> shift;
+		start = (int) ((index + 1) & TIMER_WHEEL_MASK);
+		bits = start ? (s_info.occupied[level] >> start) | (s_info.occupied[level] << (TIMER_WHEEL_SLOTS - start)) : s_info.occupied[level];
+
+		tick = (index + 1 + __builtin_ctzll(bits)) << shift;
+		if (tick < best) {
+			best = tick;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * @brief Moves the wheel to a tick, moving timers down the levels and running the timers that expire on the way.
+ */
+static void _expire(int64_t until)
+{
+	struct timer_wheel_entry *list = NULL;
+	struct timer_wheel_entry *entry = NULL;
+	int64_t tick = 0;
+	int level = 0;
+	int slot = 0;
+
+	while ((tick = _next_tick()) <= until) {
+		s_info.current = tick;
+
+		/*
+		 * Higher levels first, their timers may move to a slot of a lower level that comes around at the same tick.
+		 */
+		for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+			if (tick & (((int64_t) 1 << (TIMER_WHEEL_BITS * level)) - 1)) {
+				continue;
+			}
+
+			slot = (int) ((tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+			list = s_info.slots[level][slot];
+			s_info.slots[level][slot] = NULL;
+			s_info.occupied[level] &= ~((uint64_t) 1 << slot);
+
+			while (list) {
+				entry = list;
+				list = entry->next;
+				s_info.count--;
+				_insert(entry);
+			}
+		}
+
+		/*
+		 * A callback may add or cancel timers, so the expired timers are taken one at a time.
+		 */
+		slot = (int) (tick & TIMER_WHEEL_MASK);
+		while ((entry = s_info.slots[0][slot]) != NULL) {
+			_unlink(entry);
+			entry->cb(entry->data);
+		}
+	}
+
+	if (until > s_info.current) {
+		s_info.current = until;
+	}
+}
+
+/*
+ * @brief Sets the Ecore timer to the next tick that has work.
+ */
+static void _rearm(void)
+{
+	int64_t tick = s_info.count ? _next_tick() : TIMER_WHEEL_NONE;
+
+	if (tick == s_info.armed_tick) {
+		return;
+	}
+
+	if (s_info.timer) {
+		ecore_timer_del(s_info.timer);
+		s_info.timer = NULL;
+	}
+
+	s_info.armed_tick = tick;
+	if (tick == TIMER_WHEEL_NONE) {
+		return;
+	}
+
+	s_info.timer = ecore_timer_add(fmax(s_info.origin + tick * TIMER_WHEEL_TICK_SECONDS - ecore_time_get(), 0.0), _timer_cb, NULL);
+	if (s_info.timer == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to start the timer of the timer wheel");
+		s_info.armed_tick = TIMER_WHEEL_NONE;
+	}
+}
+
+static Eina_Bool _timer_cb(void *data)
+{
+	/*
+	 * The timer is deleted by returning ECORE_CALLBACK_CANCEL.
+	 */
+	s_info.timer = NULL;
+	s_info.armed_tick = TIMER_WHEEL_NONE;
+
+	_expire(_now_tick());
+	_rearm();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/* End of file */
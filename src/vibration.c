@@ -0,0 +1,235 @@
+/*
+ * vibration.c
+ *
+ * Vibration of the ringing alarm.
+ *
+ * A sequencer plays precompiled patterns from static tables on the vibration track of the cue timeline.
+ * Each step starts at its offset from the start of the pattern, so the latency of one step does not delay
+ * the following steps.
+ * The haptic device is opened on the first alarm and stays open until the application terminates.
+ *
+ * With CUE_HOST defined, a fake device prints the steps instead, see cue.c.
+ */
+
+#include <tizen_error.h>
+#include <stdlib.h>
+#include <haptic.h>
+#include <dlog.h>
+
+#if defined(CUE_HOST)
+#include <stdio.h>
+#endif
+
+#include "gear-reality-check.h"
+#include "cue.h"
+#include "vibration.h"
+#include "alloc-debug.h"
+
+#define COUNT_OF(array) (sizeof(array) / sizeof((array)[0]))
+
+static const struct vibration_step s_pattern_alarm[] = {
+	{ 300, 100 }, { 300, 0 },
+	{ 300, 100 }, { 300, 0 },
+	{ 300, 100 },
+};
+
+static const struct vibration_step s_pattern_gentle[] = {
+	{ 150, 40 }, { 850, 0 },
+	{ 150, 40 },
+};
+
+static const struct vibration_step s_pattern_heartbeat[] = {
+	{ 80, 100 }, { 120, 0 }, { 80, 60 }, { 720, 0 },
+	{ 80, 100 }, { 120, 0 }, { 80, 60 },
+};
+
+static const struct vibration_pattern_table {
+	const struct vibration_step *steps;
+	int num_steps;
+} s_patterns[VIBRATION_PATTERN_MAX] = {
+	[VIBRATION_PATTERN_ALARM] = { s_pattern_alarm, COUNT_OF(s_pattern_alarm) },
+	[VIBRATION_PATTERN_GENTLE] = { s_pattern_gentle, COUNT_OF(s_pattern_gentle) },
+	[VIBRATION_PATTERN_HEARTBEAT] = { s_pattern_heartbeat, COUNT_OF(s_pattern_heartbeat) },
+};
+
+static struct vibration_info {
+	haptic_device_h device;
+	haptic_effect_h effect;
+	int opened;
+	const struct vibration_pattern_table *pattern;
+	int step;
+	double deadline;
+} s_info = {
+	.device = NULL,
+	.effect = NULL,
+	.opened = 0,
+	.pattern = NULL,
+	.step = 0,
+	.deadline = 0.0,
+};
+
+static int _device_open(void);
+static int _device_vibrate(int duration_ms, int intensity);
+static void _device_stop(void);
+static void _device_close(void);
+static double _advance(double now, void *data);
+
+/*
+ * @brief Plays a pattern, replacing the pattern that is playing.
+ * @param[in] pattern The pattern to play
+ */
+void vibration_play(enum vibration_pattern pattern)
+{
+	if (pattern < 0 || pattern >= VIBRATION_PATTERN_MAX) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Unknown vibration pattern %d", pattern);
+		return;
+	}
+
+	vibration_stop();
+
+	if (!s_info.opened && _device_open() != DEVICE_ERROR_NONE) {
+		return;
+	}
+
+	s_info.pattern = &s_patterns[pattern];
+	s_info.step = 0;
+	s_info.deadline = cue_timeline_now();
+
+	cue_timeline_start(CUE_TRACK_VIBRATION, _advance, NULL);
+}
+
+/*
+ * @brief Stops the pattern that is playing. The device stays open for the next alarm.
+ * The last step may still be vibrating after the sequencer is done with the pattern, so the device is always stopped.
+ */
+void vibration_stop(void)
+{
+	if (s_info.pattern != NULL) {
+		cue_timeline_stop(CUE_TRACK_VIBRATION);
+		s_info.pattern = NULL;
+	}
+
+	_device_stop();
+}
+
+/*
+ * @brief Stops the vibration and closes the device.
+ */
+void vibration_finalize(void)
+{
+	vibration_stop();
+	_device_close();
+}
+
+/*
+ * @note Below functions are static functions.
+ */
+
+/*
+ * @brief Starts every step that is due and returns the start of the next one.
+ * The deadlines are offsets from the start of the pattern, not from the previous wake-up.
+ */
+static double _advance(double now, void *data)
+{
+	const struct vibration_step *step = NULL;
+
+	while (s_info.step < s_info.pattern->num_steps) {
+		if (s_info.deadline > now) {
+			return s_info.deadline;
+		}
+
+		step = &s_info.pattern->steps[s_info.step++];
+		if (step->intensity > 0 && _device_vibrate(step->duration_ms, step->intensity) != DEVICE_ERROR_NONE) {
+			dlog_print(DLOG_ERROR, LOG_TAG, "Error starting vibration.");
+			break;
+		}
+
+		s_info.deadline += step->duration_ms / 1000.0;
+	}
+
+	s_info.pattern = NULL;
+
+	return -1.0;
+}
+
+#if !defined(CUE_HOST)
+
+/*
+ * @brief Opens the first vibrator.
+ */
+static int _device_open(void)
+{
+	int count = 0;
+	int ret = 0;
+
+	ret = device_haptic_get_count(&count);
+	if (ret != DEVICE_ERROR_NONE || count == 0) {
+		dlog_print(DLOG_INFO, LOG_TAG, "Error or no haptic devices found.");
+		return ret != DEVICE_ERROR_NONE ? ret : DEVICE_ERROR_NOT_SUPPORTED;
+	}
+
+	ret = device_haptic_open(0, &s_info.device);
+	if (ret != DEVICE_ERROR_NONE) {
+		dlog_print(DLOG_INFO, LOG_TAG, "Error opening haptic device.");
+		return ret;
+	}
+
+	s_info.opened = 1;
+
+	return DEVICE_ERROR_NONE;
+}
+
+static int _device_vibrate(int duration_ms, int intensity)
+{
+	return device_haptic_vibrate(s_info.device, duration_ms, intensity, &s_info.effect);
+}
+
+static void _device_stop(void)
+{
+	if (s_info.opened && s_info.effect) {
+		device_haptic_stop(s_info.device, s_info.effect);
+		s_info.effect = NULL;
+	}
+}
+
+static void _device_close(void)
+{
+	if (s_info.opened) {
+		device_haptic_close(s_info.device);
+		s_info.device = NULL;
+		s_info.opened = 0;
+	}
+}
+
+#else
+
+/*
+ * Fake device. It prints when each step starts on the timeline.
+ */
+static int _device_open(void)
+{
+	printf("haptic device opened\n");
+	s_info.opened = 1;
+
+	return DEVICE_ERROR_NONE;
+}
+
+static int _device_vibrate(int duration_ms, int intensity)
+{
+	printf("%8.1f ms vibrate %d ms at %d%%\n", cue_timeline_now() * 1000.0, duration_ms, intensity);
+
+	return DEVICE_ERROR_NONE;
+}
+
+static void _device_stop(void)
+{
+}
+
+static void _device_close(void)
+{
+	s_info.opened = 0;
+}
+
+#endif
+
+/* End of file */
@@ -26,8 +26,15 @@
 #include "gear-reality-check.h"
 #include "data.h"
 #include "view.h"
+#include "schedule.h"
+#include "widget.h"
+#include "reality-check.h"
+#include "cue.h"
+#include "timer-wheel.h"
+#include "alloc-debug.h"
 
 #define FORMAT "%d/%b/%Y%I:%M%p"
+#define SECS_A_MIN 60
 
 static struct view_info {
 	Evas_Object *win;
@@ -36,6 +43,16 @@ static struct view_info {
 	Evas_Object *nf;
 	Evas_Object *genlist;
 	Evas_Object *datetime;
+	Evas_Object *countdown_label;
+	struct timer_wheel_entry countdown_timer;
+	Evas_Object *settings_spinner;
+	Evas_Object *settings_start;
+	Evas_Object *settings_end;
+	Evas_Object *settings_weekly;
+	Evas_Object *settings_adaptive;
+	Evas_Object *timed_popup;
+	double popup_dismiss_at;
+	char countdown_text[BUF_LEN];
 	Eext_Circle_Surface *circle_surface;
 } s_info = {
 	.win = NULL,
@@ -44,6 +61,15 @@ static struct view_info {
 	.nf = NULL,
 	.genlist = NULL,
 	.datetime = NULL,
+	.countdown_label = NULL,
+	.countdown_timer = { 0, },
+	.settings_spinner = NULL,
+	.settings_start = NULL,
+	.settings_end = NULL,
+	.settings_weekly = NULL,
+	.settings_adaptive = NULL,
+	.timed_popup = NULL,
+	.popup_dismiss_at = 0.0,
 	.circle_surface = NULL,
 };
 
@@ -55,7 +81,17 @@ static void _del_data(void *data, Evas_Object *obj);
 static void _icon_clicked_cb(void *data, Evas_Object *obj, void *event_info);
 static void _popup_hide_finished_cb(void *data, Evas_Object *obj, void *event_info);
 static void _popup_hide_cb(void *data, Evas_Object *obj, void *event_info);
+static void _popup_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info);
+static double _popup_timeout_cb(double now, void *data);
 static void _naviframe_back_cb(void *data, Evas_Object *obj, void *event_info);
+static void _countdown_later(void);
+static void _countdown_timer_cb(void *data);
+static void _countdown_label_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info);
+static void _settings_changed_cb(void *data, Evas_Object *obj, void *event_info);
+static void _settings_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info);
+static void _adaptive_changed_cb(void *data, Evas_Object *obj, void *event_info);
+static void _weekly_quota_changed_cb(void *data, Evas_Object *obj, void *event_info);
+static void _set_settings_time(Evas_Object *datetime, const struct tm *time_of_day);
 
 /*
  * @brief Gets window.
@@ -256,30 +292,6 @@ Evas_Object *view_create_layout(Evas_Object *parent, const char *file_path, cons
 
 	box = elm_box_add(scroller);
 
-	// Label for the number of reminders
-	Evas_Object *label_num_reminders = view_create_label(box, "Number of reminders");
-	view_box_pack(box, label_num_reminders);
-
-	// Spinner
-	Evas_Object *spinner_num_reminders = view_create_spinner(box);
-	view_box_pack(box, spinner_num_reminders);
-
-	// Label for the earliest time
-	Evas_Object *label_min_time = view_create_label(box, "Earliest time");
-	view_box_pack(box, label_min_time);
-
-	// Datetime
-	Evas_Object * datetime_min_time = view_create_datetime(box);
-	view_box_pack(box, datetime_min_time);
-
-	// Label for the latest time
-	Evas_Object *label_max_time = view_create_label(box, "Latest time");
-	view_box_pack(box, label_max_time);
-
-	// Datetime
-	Evas_Object * datetime_max_time = view_create_datetime(box);
-	view_box_pack(box, datetime_max_time);
-
 	// @@TODO: https://developer.tizen.org/dev-guide/2.3.1/org.tizen.guides/html/native/ui/styles_wn.htm
 
 	evas_object_size_hint_weight_set(scroller, EVAS_HINT_FILL, EVAS_HINT_EXPAND);
@@ -310,6 +322,110 @@ Evas_Object *view_create_layout(Evas_Object *parent, const char *file_path, cons
 	return scroller;
 }
 
+/*
+ * @brief Adds the countdown and the settings of the planner to a layout made by view_create_layout().
+ * Only the base layout has them, so the countdown and the settings in view_info always belong to it.
+ * @param[in] layout The layout made by view_create_layout()
+ */
+Eina_Bool view_create_settings_box(Evas_Object *layout)
+{
+	Evas_Object *box = NULL;
+
+	if (layout == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "layout is NULL.");
+		return EINA_FALSE;
+	}
+
+	box = elm_object_content_get(layout);
+	if (box == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "layout has no box.");
+		return EINA_FALSE;
+	}
+
+	// Countdown to the next reality check, updated at every full minute
+	s_info.countdown_label = view_create_label(box, NULL);
+	view_box_pack(box, s_info.countdown_label);
+	evas_object_event_callback_add(s_info.countdown_label, EVAS_CALLBACK_DEL, _countdown_label_del_cb, NULL);
+	view_update_countdown();
+	if (!timer_wheel_pending(&s_info.countdown_timer)) {
+		_countdown_later();
+	}
+
+	// Label for the number of reminders
+	Evas_Object *label_num_reminders = view_create_label(box, "Number of reminders");
+	view_box_pack(box, label_num_reminders);
+
+	// Spinner
+	Evas_Object *spinner_num_reminders = view_create_spinner(box);
+	view_box_pack(box, spinner_num_reminders);
+
+	// Label for the number of reminders per week
+	Evas_Object *label_weekly_quota = view_create_label(box, "Reminders per week (0: per day)");
+	view_box_pack(box, label_weekly_quota);
+
+	// Spinner, a weekly quota replaces the number of reminders per day
+	Evas_Object *spinner_weekly_quota = view_create_spinner(box);
+	view_box_pack(box, spinner_weekly_quota);
+	elm_spinner_min_max_set(spinner_weekly_quota, 0, 70);
+	elm_spinner_value_set(spinner_weekly_quota, get_weekly_quota());
+	evas_object_smart_callback_add(spinner_weekly_quota, "delay,changed", _weekly_quota_changed_cb, NULL);
+	s_info.settings_weekly = spinner_weekly_quota;
+
+	// Label for the earliest time
+	Evas_Object *label_min_time = view_create_label(box, "Earliest time");
+	view_box_pack(box, label_min_time);
+
+	// Datetime
+	Evas_Object * datetime_min_time = view_create_datetime(box);
+	view_box_pack(box, datetime_min_time);
+
+	// Label for the latest time
+	Evas_Object *label_max_time = view_create_label(box, "Latest time");
+	view_box_pack(box, label_max_time);
+
+	// Datetime
+	Evas_Object * datetime_max_time = view_create_datetime(box);
+	view_box_pack(box, datetime_max_time);
+
+	// Check for drawing the reminders at the hours that get responses
+	Evas_Object *check_adaptive = elm_check_add(box);
+	elm_object_text_set(check_adaptive, "Adapt to my responses");
+	elm_check_state_set(check_adaptive, is_adaptive_sampling());
+	evas_object_smart_callback_add(check_adaptive, "changed", _adaptive_changed_cb, NULL);
+	s_info.settings_adaptive = check_adaptive;
+	evas_object_show(check_adaptive);
+	view_box_pack(box, check_adaptive);
+
+	// Show the current settings, a change plans again right away
+	int num_reminders;
+	struct tm start_time;
+	struct tm end_time;
+	get_reminder_settings(&num_reminders, &start_time, &end_time);
+
+	elm_spinner_min_max_set(spinner_num_reminders, 1, 10);
+	elm_spinner_value_set(spinner_num_reminders, num_reminders);
+	_set_settings_time(datetime_min_time, &start_time);
+	_set_settings_time(datetime_max_time, &end_time);
+
+	s_info.settings_spinner = spinner_num_reminders;
+	s_info.settings_start = datetime_min_time;
+	s_info.settings_end = datetime_max_time;
+	evas_object_smart_callback_add(spinner_num_reminders, "delay,changed", _settings_changed_cb, NULL);
+	evas_object_smart_callback_add(datetime_min_time, "changed", _settings_changed_cb, NULL);
+	evas_object_smart_callback_add(datetime_max_time, "changed", _settings_changed_cb, NULL);
+
+	/*
+	 * The settings are deleted with the base layout, the callbacks must not read them afterwards.
+	 */
+	evas_object_event_callback_add(spinner_num_reminders, EVAS_CALLBACK_DEL, _settings_del_cb, NULL);
+	evas_object_event_callback_add(datetime_min_time, EVAS_CALLBACK_DEL, _settings_del_cb, NULL);
+	evas_object_event_callback_add(datetime_max_time, EVAS_CALLBACK_DEL, _settings_del_cb, NULL);
+	evas_object_event_callback_add(spinner_weekly_quota, EVAS_CALLBACK_DEL, _settings_del_cb, NULL);
+	evas_object_event_callback_add(check_adaptive, EVAS_CALLBACK_DEL, _settings_del_cb, NULL);
+
+	return EINA_TRUE;
+}
+
 /*
  * @brief Make layout with theme.
  * @param[in] parent The object to which you want to add this layout
@@ -346,6 +462,17 @@ Evas_Object *view_create_layout_by_theme(Evas_Object *parent, const char *class,
  */
 void view_destroy(void)
 {
+	timer_wheel_cancel(&s_info.countdown_timer);
+	s_info.countdown_label = NULL;
+	s_info.settings_spinner = NULL;
+	s_info.settings_start = NULL;
+	s_info.settings_end = NULL;
+	s_info.settings_weekly = NULL;
+	s_info.settings_adaptive = NULL;
+
+	cue_timeline_stop(CUE_TRACK_POPUP);
+	s_info.timed_popup = NULL;
+
 	if (s_info.win == NULL)
 		return;
 
@@ -375,6 +502,60 @@ void view_alarm_destroy(void)
 	}
 }
 
+/*
+ * @brief Formats the time texts of all genlist's items again, e.g. when the language is changed.
+ */
+void view_alarm_update_time_texts(void)
+{
+	struct genlist_item_data *gendata = NULL;
+	Elm_Object_Item *item = NULL;
+	int item_count = 0;
+	int i;
+
+	if (s_info.genlist == NULL) {
+		return;
+	}
+
+	item_count = elm_genlist_items_count(s_info.genlist);
+
+	/*
+	 * The fist item and the last item are "padding".
+	 */
+	for (i = 1; i < item_count - 1; i++) {
+		item = elm_genlist_nth_item_get(s_info.genlist, i);
+		gendata = elm_object_item_data_get(item);
+		if (gendata) {
+			data_update_time_text(gendata);
+		}
+	}
+
+	elm_genlist_realized_items_update(s_info.genlist);
+}
+
+/*
+ * @brief Shows the time left until the next reality check on the main screen.
+ * The text is formatted into a static buffer, so updating it does not allocate.
+ */
+void view_update_countdown(void)
+{
+	int64_t now = (int64_t) time(NULL);
+	int index = 0;
+
+	if (s_info.countdown_label == NULL) {
+		return;
+	}
+
+	index = schedule_store_next_after(now);
+	if (index < 0) {
+		snprintf(s_info.countdown_text, sizeof(s_info.countdown_text), "%s", "No reality check scheduled.");
+	} else {
+		data_format_countdown((time_t) schedule_store_get_epoch(index), (time_t) now, "Next reality check",
+				s_info.countdown_text, sizeof(s_info.countdown_text));
+	}
+
+	elm_object_text_set(s_info.countdown_label, s_info.countdown_text);
+}
+
 /*
  * @brief Sets a image to given part.
  * @param[in] parent The object has part to which you want to set this image
@@ -714,7 +895,17 @@ void view_create_text_popup(Evas_Object *parent, double timeout, const char *tex
 
 	elm_object_content_set(popup, popup_layout);
 
-	elm_popup_timeout_set(popup, timeout);
+	/*
+	 * The timeout is a track of the cue timeline instead of a timer of the popup.
+	 * A popup that is still shown is dismissed by the new one.
+	 */
+	if (s_info.timed_popup) {
+		elm_popup_dismiss(s_info.timed_popup);
+	}
+	s_info.timed_popup = popup;
+	evas_object_event_callback_add(popup, EVAS_CALLBACK_DEL, _popup_del_cb, NULL);
+	s_info.popup_dismiss_at = cue_timeline_now() + timeout;
+	cue_timeline_start(CUE_TRACK_POPUP, _popup_timeout_cb, popup);
 
 	if (text) {
 		view_set_text(popup_layout, "elm.text", text);
@@ -773,8 +964,8 @@ void view_send_signal_to_edje(Evas_Object *layout, const char *signal, const cha
  */
 void view_alarm_schedule_alarm(struct genlist_item_data *gendata)
 {
-	app_control_h app_control;
 	struct tm *saved_time = NULL;
+	struct tm set_time = { 0, };
 	int alarm_id = 0;
 
 	if (gendata == NULL) {
@@ -785,23 +976,28 @@ void view_alarm_schedule_alarm(struct genlist_item_data *gendata)
 	/*
 	 * Get the time that user sets.
 	 */
-	saved_time = &gendata->saved_time;
-	elm_datetime_value_get(s_info.datetime, saved_time);
+	elm_datetime_value_get(s_info.datetime, &set_time);
 
 	/*
 	 * Initialize seconds.
 	 */
-	saved_time->tm_sec = 0;
+	set_time.tm_sec = 0;
+
+	/*
+	 * Store the time in gendata, which also formats the text shown in the genlist.
+	 */
+	data_set_saved_time(gendata, &set_time);
+	saved_time = &gendata->saved_time;
 
 	dlog_print(DLOG_INFO, LOG_TAG, "saved time (%d:%d)", saved_time->tm_hour, saved_time->tm_min);
 
 	/*
 	 * Set alarm by using alarm API.
 	 */
-	app_control = data_get_app_control();
-
-	if (ALARM_ERROR_NONE != alarm_schedule_at_date(app_control, saved_time, 0, &alarm_id)) {
-		dlog_print(DLOG_ERROR, LOG_TAG, "Failed at alarm_schedule_at_date(). Alarm is not set.");
+	if (ALARM_ERROR_NONE != data_schedule_alarm(gendata, &alarm_id)) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed at data_schedule_alarm(). Alarm is not set.");
+	} else {
+		schedule_store_add(data_get_saved_epoch(gendata), alarm_id, SCHEDULE_STATE_PENDING, SCHEDULE_ORIGIN_USER);
 	}
 	dlog_print(DLOG_INFO, LOG_TAG, "alarm ID is [%d]", alarm_id);
 
@@ -809,6 +1005,8 @@ void view_alarm_schedule_alarm(struct genlist_item_data *gendata)
 	 * Store alarm ID in gendata with the generated alarm ID.
 	 */
 	gendata->alarm_id = alarm_id;
+
+	view_update_countdown();
 }
 
 
@@ -950,8 +1148,6 @@ static void _icon_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 	widget_alarm = data_check_exist_widget_alarm(gendata);
 
 	if (state == EINA_TRUE) {
-		app_control_h app_control;
-
 		/*
 		 * Store the current state of check box in gendata.
 		 */
@@ -961,13 +1157,15 @@ static void _icon_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 		 * Reset alarm using time that user sets before.
 		 * But, alarm ID is new.
 		 */
-		app_control = data_get_app_control();
-		alarm_schedule_at_date(app_control, saved_time, 0, &alarm_id);
+		data_schedule_alarm(gendata, &alarm_id);
 
 		/*
-		 * Store the new alarm ID in gendata.
+		 * Store the new alarm ID in gendata and in the schedule store.
+		 * The widgets showing the alarm follow it to the new ID.
 		 */
+		widget_registry_move_alarm(gendata->alarm_id, alarm_id);
 		gendata->alarm_id = alarm_id;
+		schedule_store_add(data_get_saved_epoch(gendata), alarm_id, SCHEDULE_STATE_PENDING, SCHEDULE_ORIGIN_USER);
 
 		/*
 		 * Add bundle using specific alarm ID as key.
@@ -989,6 +1187,7 @@ static void _icon_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 		 * Cancels the alarm with the specific alarm ID.
 		 */
 		alarm_cancel(alarm_id);
+		schedule_store_remove(alarm_id);
 
 		/*
 		 * Remove bundle using specific alarm ID as key.
@@ -1004,6 +1203,9 @@ static void _icon_clicked_cb(void *data, Evas_Object *obj, void *event_info)
 
 	dlog_print(DLOG_INFO, LOG_TAG, "icon state is [%d], alarm ID [%d], saved time (%d:%d)",
 			state, alarm_id, saved_time->tm_hour, saved_time->tm_min);
+
+	view_update_countdown();
+	widget_payload_push();
 }
 
 /*
@@ -1023,6 +1225,31 @@ static void _popup_hide_finished_cb(void *data, Evas_Object *obj, void *event_in
 	evas_object_del(obj);
 }
 
+/*
+ * @brief Stops the timeout of the popup when the popup is deleted, with or without being dismissed.
+ */
+static void _popup_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info)
+{
+	if (obj == s_info.timed_popup) {
+		cue_timeline_stop(CUE_TRACK_POPUP);
+		s_info.timed_popup = NULL;
+	}
+}
+
+/*
+ * @brief Dismisses the popup when its timeout has passed.
+ */
+static double _popup_timeout_cb(double now, void *data)
+{
+	if (now < s_info.popup_dismiss_at) {
+		return s_info.popup_dismiss_at;
+	}
+
+	elm_popup_dismiss(data);
+
+	return -1.0;
+}
+
 /*
  * @brief This function will be operated when the H/W Back Key event occurred.
  * @param[in] data Data needed in this function
@@ -1041,6 +1268,159 @@ static void _popup_hide_cb(void *data, Evas_Object *obj, void *event_info)
 	elm_popup_dismiss(obj);
 }
 
+/*
+ * @brief Sets the countdown timer to the next full minute.
+ */
+static void _countdown_later(void)
+{
+	timer_wheel_add(&s_info.countdown_timer, SECS_A_MIN - time(NULL) % SECS_A_MIN, TIMER_GROUP_NONE, _countdown_timer_cb, NULL);
+}
+
+/*
+ * @brief This function will be operated at every full minute to update the countdown.
+ * The timer is set again from the clock, so it does not drift.
+ * @param[in] data Data needed in this function
+ */
+static void _countdown_timer_cb(void *data)
+{
+	view_update_countdown();
+	_countdown_later();
+}
+
+/*
+ * @brief Stops the countdown when its label is deleted with the base layout.
+ */
+static void _countdown_label_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info)
+{
+	if (obj != s_info.countdown_label) {
+		return;
+	}
+
+	s_info.countdown_label = NULL;
+	timer_wheel_cancel(&s_info.countdown_timer);
+}
+
+/*
+ * @brief This function will be operated when a setting of the planner is changed.
+ * The planner changes only the reminders that do not fit the new settings.
+ * @param[in] data Data needed in this function
+ * @param[in] obj The spinner or datetime that has changed
+ * @param[in] event_info The information of the event
+ */
+static void _settings_changed_cb(void *data, Evas_Object *obj, void *event_info)
+{
+	struct tm start_time;
+	struct tm end_time;
+	int num_reminders = 0;
+	int calls = 0;
+
+	if (s_info.settings_spinner == NULL || s_info.settings_start == NULL || s_info.settings_end == NULL) {
+		return;
+	}
+
+	/*
+	 * A setting that cannot be read would plan with garbage, which can cancel every reminder.
+	 */
+	num_reminders = (int) elm_spinner_value_get(s_info.settings_spinner);
+	if (num_reminders < 1) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Invalid number of reminders %d.", num_reminders);
+		return;
+	}
+
+	if (!elm_datetime_value_get(s_info.settings_start, &start_time) ||
+			!elm_datetime_value_get(s_info.settings_end, &end_time)) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to get the time of the settings.");
+		return;
+	}
+
+	calls = set_reminder_settings(data_get_app_control(), num_reminders, &start_time, &end_time);
+	if (calls > 0) {
+		view_update_countdown();
+		widget_payload_push();
+	}
+}
+
+/*
+ * @brief This function will be operated when the number of reminders per week is changed.
+ * @param[in] data Data needed in this function
+ * @param[in] obj The spinner
+ * @param[in] event_info The information of the event
+ */
+static void _weekly_quota_changed_cb(void *data, Evas_Object *obj, void *event_info)
+{
+	int calls = 0;
+	int quota = 0;
+
+	if (obj == NULL || obj != s_info.settings_weekly) {
+		return;
+	}
+
+	quota = (int) elm_spinner_value_get(obj);
+	if (quota < 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Invalid weekly quota %d.", quota);
+		return;
+	}
+
+	calls = set_weekly_quota(data_get_app_control(), quota);
+	if (calls > 0) {
+		view_update_countdown();
+		widget_payload_push();
+	}
+}
+
+/*
+ * @brief This function will be operated when adaptive timing is turned on or off.
+ * The reminders that are planned already stay, the days planned from now on follow the new setting.
+ * @param[in] data Data needed in this function
+ * @param[in] obj The check
+ * @param[in] event_info The information of the event
+ */
+static void _adaptive_changed_cb(void *data, Evas_Object *obj, void *event_info)
+{
+	if (obj == NULL || obj != s_info.settings_adaptive) {
+		return;
+	}
+
+	set_adaptive_sampling(elm_check_state_get(obj));
+}
+
+/*
+ * @brief Forgets a setting of the base layout when it is deleted.
+ */
+static void _settings_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info)
+{
+	if (obj == s_info.settings_spinner) {
+		s_info.settings_spinner = NULL;
+	} else if (obj == s_info.settings_start) {
+		s_info.settings_start = NULL;
+	} else if (obj == s_info.settings_end) {
+		s_info.settings_end = NULL;
+	} else if (obj == s_info.settings_weekly) {
+		s_info.settings_weekly = NULL;
+	} else if (obj == s_info.settings_adaptive) {
+		s_info.settings_adaptive = NULL;
+	}
+}
+
+/*
+ * @brief Shows a time of day of the settings in a datetime.
+ * @param[in] datetime The datetime
+ * @param[in] time_of_day The time, only hours and minutes are used
+ */
+static void _set_settings_time(Evas_Object *datetime, const struct tm *time_of_day)
+{
+	struct tm value;
+	time_t now = time(NULL);
+
+	localtime_r(&now, &value);
+	value.tm_hour = time_of_day->tm_hour;
+	value.tm_min = time_of_day->tm_min;
+	value.tm_sec = 0;
+
+	elm_datetime_format_set(datetime, "%I:%M%p");
+	elm_datetime_value_set(datetime, &value);
+}
+
 /*
  * @brief This function will be operated when the Back key is pressed.
  * @param[in] data Data has the same value passed to eext_object_event_callback_add() as the data parameter
@@ -0,0 +1,869 @@
+/*
+ * widget.c
+ *
+ * Updates of the widget.
+ *
+ * Live widget instances are kept in a registry indexed by their instance ID.
+ * Each instance subscribes to the alarms it shows, so a change of an alarm
+ * reaches every instance that shows it.
+ * The payload is built from the schedule store and sent once per change of the schedule,
+ * so the widgets can show the next reality check without asking the app.
+ * All data for widgets goes through an update queue of messages, an operation with the alarm it is about
+ * and its values. Messages of the same operation for the same alarm are merged, and the queue is sent when the main loop
+ * becomes idle. The widget keeps the values it got for an alarm, so a message carries only the keys whose values
+ * differ from the ones sent last for its alarm, and a message without such keys is not sent.
+ */
+
+#include <time.h>
+#include <stdint.h>
+#include <Elementary.h>
+#include <Ecore.h>
+#include <app.h>
+#include <dlog.h>
+#include <bundle.h>
+#include <app_preference.h>
+#include <widget_service.h>
+#include <widget_errno.h>
+
+#include "gear-reality-check.h"
+#include "data.h"
+#include "schedule.h"
+#include "reality-check.h"
+#include "widget.h"
+
+#define WIDGET_REGISTRY_KEY "widget_registry"
+
+#define WIDGET_MAX_INSTANCES 16
+#define WIDGET_MAX_SUBSCRIPTIONS 16
+#define WIDGET_MAX_QUEUED 8
+#define WIDGET_ID_LEN 256
+#define WIDGET_KEY_LEN 32
+#define WIDGET_VALUE_LEN 64
+#define WIDGET_OPERATION_KEY "Operation"
+#define WIDGET_ALARM_ID_KEY "AlarmId"
+#define WIDGET_NO_ALARM -1
+
+/*
+ * The keys the widget reads, besides the operation and the alarm ID. A message holds each key once,
+ * so it never has more values than there are keys.
+ */
+static const char *const s_widget_keys[] = {
+	"AlarmTime",
+	"OnOff",
+	"Slot",
+	"NextTime",
+	"NextText",
+	"RemainingToday",
+	"Streak",
+};
+
+#define WIDGET_MAX_FIELDS (sizeof(s_widget_keys) / sizeof(s_widget_keys[0]))
+
+/*
+ * A message waiting to be sent to a widget instance. The operation and the alarm ID are sent along with the values.
+ * The keys are indexes into s_widget_keys.
+ */
+struct widget_message {
+	char operation[WIDGET_KEY_LEN];
+	int alarm_id;
+	int keys[WIDGET_MAX_FIELDS];
+	char values[WIDGET_MAX_FIELDS][WIDGET_VALUE_LEN];
+	int field_count;
+};
+
+/*
+ * The values last sent about an alarm, or about no alarm, kept as a digest per key of s_widget_keys.
+ */
+struct widget_sent {
+	int alarm_id;
+	unsigned int known;
+	uint64_t digests[WIDGET_MAX_FIELDS];
+};
+
+struct widget_instance {
+	char widget_id[WIDGET_ID_LEN];
+	char instance_id[WIDGET_ID_LEN];
+	int alarm_ids[WIDGET_MAX_SUBSCRIPTIONS];
+	int alarm_count;
+	struct widget_message queue[WIDGET_MAX_QUEUED];
+	int queued;
+	struct widget_sent sent[WIDGET_MAX_SUBSCRIPTIONS + 1];
+	int sent_count;
+	Eina_Bool dirty;
+	Eina_Bool gone;
+};
+
+static struct widget_info {
+	Eina_Hash *instances;
+	struct widget_instance *dirty[WIDGET_MAX_INSTANCES];
+	int dirty_count;
+	Ecore_Idler *flush_idler;
+	int sent_count;
+	int suppressed_count;
+	Eina_Bool pushed;
+	unsigned int pushed_generation;
+	int64_t pushed_day;
+} s_info = {
+	.instances = NULL,
+	.dirty_count = 0,
+	.flush_idler = NULL,
+	.sent_count = 0,
+	.suppressed_count = 0,
+	.pushed = EINA_FALSE,
+	.pushed_generation = 0,
+	.pushed_day = 0,
+};
+
+static struct widget_instance *_add_instance(const char *widget_id, const char *instance_id);
+static Eina_Bool _is_subscribed(struct widget_instance *instance, int alarm_id);
+static void _queue_message(struct widget_instance *instance, int alarm_id, const char *operation,
+		const struct widget_value *values, int count);
+static void _message_set(struct widget_message *message, const char *key, const char *value);
+static void _flush_instance(struct widget_instance *instance);
+static void _send_message(struct widget_instance *instance, const struct widget_message *message);
+static struct widget_sent *_get_sent(struct widget_instance *instance, int alarm_id);
+static uint64_t _value_digest(const char *value);
+static Eina_Bool _flush_idler_cb(void *data);
+static void _load_registry(void);
+static void _save_registry(void);
+static Eina_Bool _save_instance_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata);
+static Eina_Bool _send_for_alarm_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata);
+static Eina_Bool _push_payload_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata);
+static Eina_Bool _move_alarm_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata);
+
+/*
+ * Arguments of the callbacks iterating over the registry.
+ */
+struct widget_alarm_message {
+	int alarm_id;
+	const char *operation;
+	const struct widget_value *values;
+	int count;
+};
+
+struct widget_alarm_move {
+	int old_alarm_id;
+	int new_alarm_id;
+	Eina_Bool changed;
+};
+
+/*
+ * @brief Creates the registry and loads the widget instances known from earlier launches.
+ */
+void widget_registry_initialize(void)
+{
+	if (s_info.instances) {
+		return;
+	}
+
+	s_info.instances = eina_hash_string_superfast_new(free);
+	if (s_info.instances == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to create the widget registry.");
+		return;
+	}
+
+	_load_registry();
+}
+
+/*
+ * @brief Frees the registry. Queued updates are dropped, flush them before.
+ */
+void widget_registry_finalize(void)
+{
+	if (s_info.flush_idler) {
+		ecore_idler_del(s_info.flush_idler);
+		s_info.flush_idler = NULL;
+	}
+
+	s_info.dirty_count = 0;
+
+	if (s_info.instances) {
+		eina_hash_free(s_info.instances);
+		s_info.instances = NULL;
+	}
+}
+
+/*
+ * @brief Adds a live widget instance to the registry, if it is not known yet.
+ * @param[in] widget_id ID of the widget
+ * @param[in] instance_id ID of the widget instance
+ */
+void widget_registry_add(const char *widget_id, const char *instance_id)
+{
+	if (widget_id == NULL || instance_id == NULL || s_info.instances == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] invalid parameter", __func__, __LINE__);
+		return;
+	}
+
+	if (eina_hash_find(s_info.instances, instance_id)) {
+		return;
+	}
+
+	if (_add_instance(widget_id, instance_id)) {
+		_save_registry();
+
+		/*
+		 * The new instance has not received the payload yet.
+		 */
+		widget_payload_invalidate();
+	}
+}
+
+/*
+ * @brief Removes a widget instance from the registry.
+ * @param[in] instance_id ID of the widget instance
+ */
+void widget_registry_remove(const char *instance_id)
+{
+	struct widget_instance *instance = NULL;
+	int i;
+
+	if (instance_id == NULL || s_info.instances == NULL) {
+		return;
+	}
+
+	instance = eina_hash_find(s_info.instances, instance_id);
+	if (instance == NULL) {
+		return;
+	}
+
+	for (i = 0; i < s_info.dirty_count; i++) {
+		if (s_info.dirty[i] == instance) {
+			s_info.dirty[i] = s_info.dirty[--s_info.dirty_count];
+			break;
+		}
+	}
+
+	eina_hash_del_by_key(s_info.instances, instance_id);
+	_save_registry();
+}
+
+/*
+ * @brief Subscribes a widget instance to the changes of an alarm.
+ * @param[in] instance_id ID of the widget instance
+ * @param[in] alarm_id ID of the alarm
+ */
+void widget_registry_subscribe(const char *instance_id, int alarm_id)
+{
+	struct widget_instance *instance = NULL;
+
+	if (instance_id == NULL || s_info.instances == NULL) {
+		return;
+	}
+
+	instance = eina_hash_find(s_info.instances, instance_id);
+	if (instance == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Widget instance %s is not registered.", instance_id);
+		return;
+	}
+
+	if (_is_subscribed(instance, alarm_id)) {
+		return;
+	}
+
+	if (instance->alarm_count == WIDGET_MAX_SUBSCRIPTIONS) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Widget instance %s has too many alarms.", instance_id);
+		return;
+	}
+
+	instance->alarm_ids[instance->alarm_count++] = alarm_id;
+	_save_registry();
+}
+
+/*
+ * @brief Removes the subscriptions to an alarm from all widget instances.
+ * @param[in] alarm_id ID of the alarm
+ */
+void widget_registry_unsubscribe_alarm(int alarm_id)
+{
+	widget_registry_move_alarm(alarm_id, -1);
+}
+
+/*
+ * @brief Moves the subscriptions from one alarm ID to another, e.g. when an alarm is scheduled again.
+ * @param[in] old_alarm_id ID the alarm had before
+ * @param[in] new_alarm_id ID the alarm has now, or -1 to remove the subscriptions
+ */
+void widget_registry_move_alarm(int old_alarm_id, int new_alarm_id)
+{
+	struct widget_alarm_move move = { old_alarm_id, new_alarm_id, EINA_FALSE };
+
+	if (s_info.instances == NULL) {
+		return;
+	}
+
+	eina_hash_foreach(s_info.instances, _move_alarm_cb, &move);
+	if (move.changed) {
+		_save_registry();
+	}
+}
+
+/*
+ * @brief Queues a message for all widget instances subscribed to an alarm. The ID of the alarm is sent along.
+ * @param[in] alarm_id ID of the alarm
+ * @param[in] operation The operation of the message
+ * @param[in] values The values of the message, may be NULL if there are none
+ * @param[in] count The number of values
+ */
+void widget_registry_send_for_alarm(int alarm_id, const char *operation, const struct widget_value *values, int count)
+{
+	struct widget_alarm_message alarm_message = { alarm_id, operation, values, count };
+
+	if (operation == NULL || (values == NULL && count > 0) || s_info.instances == NULL) {
+		return;
+	}
+
+	eina_hash_foreach(s_info.instances, _send_for_alarm_cb, &alarm_message);
+}
+
+/*
+ * @brief Builds the payload for the widget.
+ * @param[out] payload The payload
+ * @param[in] now Current time in seconds since the epoch
+ */
+void widget_payload_build(struct widget_payload *payload, int64_t now)
+{
+	time_t next_t;
+	struct tm next_time;
+	int index = 0;
+
+	if (payload == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "payload is NULL");
+		return;
+	}
+
+	memset(payload, 0, sizeof(*payload));
+
+	index = schedule_store_next_after(now);
+	payload->next_epoch = schedule_store_get_epoch(index);
+	payload->remaining_today = schedule_store_count_between(now, schedule_day_next(schedule_day_start(now)));
+	payload->streak = get_streak(now);
+
+	if (payload->next_epoch >= 0) {
+		next_t = (time_t) payload->next_epoch;
+		localtime_r(&next_t, &next_time);
+		strftime(payload->next_text, sizeof(payload->next_text), TIME_TEXT_FORMAT, &next_time);
+	}
+}
+
+/*
+ * @brief Pushes the payload to all widget instances if the schedule has changed since the last push.
+ * The remaining count and the streak depend on the day, so a new day also causes a push.
+ * Values that have not changed are not sent again by the update queue.
+ */
+void widget_payload_push(void)
+{
+	struct widget_payload payload;
+	int64_t now = (int64_t) time(NULL);
+	int64_t today = schedule_day_start(now);
+	unsigned int generation = schedule_store_get_generation();
+
+	if (s_info.pushed && s_info.pushed_generation == generation && s_info.pushed_day == today) {
+		return;
+	}
+
+	if (s_info.instances == NULL || eina_hash_population(s_info.instances) == 0) {
+		dlog_print(DLOG_INFO, LOG_TAG, "No widget to push to.");
+		return;
+	}
+
+	widget_payload_build(&payload, now);
+	eina_hash_foreach(s_info.instances, _push_payload_cb, &payload);
+
+	s_info.pushed = EINA_TRUE;
+	s_info.pushed_generation = generation;
+	s_info.pushed_day = today;
+}
+
+/*
+ * @brief Makes the next widget_payload_push() rebuild the payload, e.g. when the streak has changed.
+ */
+void widget_payload_invalidate(void)
+{
+	s_info.pushed = EINA_FALSE;
+}
+
+/*
+ * @brief Sends all queued values now, e.g. before the application terminates.
+ * Instances that do not exist anymore are removed from the registry.
+ */
+void widget_queue_flush(void)
+{
+	struct widget_instance *instance = NULL;
+	int count = s_info.dirty_count;
+	int i;
+
+	if (s_info.flush_idler) {
+		ecore_idler_del(s_info.flush_idler);
+		s_info.flush_idler = NULL;
+	}
+
+	s_info.dirty_count = 0;
+
+	for (i = 0; i < count; i++) {
+		_flush_instance(s_info.dirty[i]);
+	}
+
+	for (i = 0; i < count; i++) {
+		instance = s_info.dirty[i];
+		if (instance->gone) {
+			dlog_print(DLOG_INFO, LOG_TAG, "Widget instance %s does not exist anymore.", instance->instance_id);
+			widget_registry_remove(instance->instance_id);
+		}
+	}
+}
+
+/*
+ * @brief Gets the number of messages that did not cause an update of their own,
+ * because they were merged into a queued one or had no value the widget did not have already.
+ */
+int widget_queue_get_suppressed_count(void)
+{
+	return s_info.suppressed_count;
+}
+
+/*
+ * @note
+ * Below functions are static functions.
+ */
+
+/*
+ * @brief Creates a widget instance and adds it to the registry.
+ */
+static struct widget_instance *_add_instance(const char *widget_id, const char *instance_id)
+{
+	struct widget_instance *instance = NULL;
+
+	if (eina_hash_population(s_info.instances) == WIDGET_MAX_INSTANCES) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Too many widget instances, %s is not registered.", instance_id);
+		return NULL;
+	}
+
+	instance = calloc(1, sizeof(*instance));
+	if (instance == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to allocate a widget instance.");
+		return NULL;
+	}
+
+	snprintf(instance->widget_id, sizeof(instance->widget_id), "%s", widget_id);
+	snprintf(instance->instance_id, sizeof(instance->instance_id), "%s", instance_id);
+
+	if (!eina_hash_add(s_info.instances, instance->instance_id, instance)) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to register widget instance %s.", instance_id);
+		free(instance);
+		return NULL;
+	}
+
+	return instance;
+}
+
+/*
+ * @brief Checks whether a widget instance is subscribed to an alarm.
+ */
+static Eina_Bool _is_subscribed(struct widget_instance *instance, int alarm_id)
+{
+	int i;
+
+	for (i = 0; i < instance->alarm_count; i++) {
+		if (instance->alarm_ids[i] == alarm_id) {
+			return EINA_TRUE;
+		}
+	}
+
+	return EINA_FALSE;
+}
+
+/*
+ * @brief Queues a message for a widget instance. It is sent when the main loop becomes idle.
+ * A queued message of the same operation for the same alarm takes the new values and moves to the end of the queue,
+ * so the widget gets the latest state after the messages queued in between.
+ */
+static void _queue_message(struct widget_instance *instance, int alarm_id, const char *operation,
+		const struct widget_value *values, int count)
+{
+	struct widget_message merged;
+	struct widget_message *message = NULL;
+	int i;
+
+	for (i = 0; i < instance->queued; i++) {
+		if (instance->queue[i].alarm_id == alarm_id && !strcmp(instance->queue[i].operation, operation)) {
+			break;
+		}
+	}
+
+	if (i < instance->queued) {
+		s_info.suppressed_count++;
+		merged = instance->queue[i];
+		memmove(&instance->queue[i], &instance->queue[i + 1], (instance->queued - i - 1) * sizeof(instance->queue[0]));
+		instance->queue[instance->queued - 1] = merged;
+		message = &instance->queue[instance->queued - 1];
+	} else {
+		/*
+		 * The queue is full, the oldest message goes out now to make room.
+		 */
+		if (instance->queued == WIDGET_MAX_QUEUED) {
+			_send_message(instance, &instance->queue[0]);
+			memmove(&instance->queue[0], &instance->queue[1], (WIDGET_MAX_QUEUED - 1) * sizeof(instance->queue[0]));
+			instance->queued--;
+		}
+
+		message = &instance->queue[instance->queued++];
+		snprintf(message->operation, sizeof(message->operation), "%s", operation);
+		message->alarm_id = alarm_id;
+		message->field_count = 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		_message_set(message, values[i].key, values[i].value);
+	}
+
+	if (!instance->dirty) {
+		instance->dirty = EINA_TRUE;
+		s_info.dirty[s_info.dirty_count++] = instance;
+	}
+
+	if (s_info.flush_idler == NULL) {
+		s_info.flush_idler = ecore_idler_add(_flush_idler_cb, NULL);
+	}
+}
+
+/*
+ * @brief Sets a value of a queued message, replacing the value the key had. Keys the widget does not read are dropped.
+ */
+static void _message_set(struct widget_message *message, const char *key, const char *value)
+{
+	int key_index = 0;
+	int i;
+
+	for (i = 0; i < (int) WIDGET_MAX_FIELDS; i++) {
+		if (!strcmp(s_widget_keys[i], key)) {
+			break;
+		}
+	}
+
+	if (i == (int) WIDGET_MAX_FIELDS) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Unknown widget key %s, it is not sent.", key);
+		return;
+	}
+
+	key_index = i;
+	for (i = 0; i < message->field_count; i++) {
+		if (message->keys[i] == key_index) {
+			break;
+		}
+	}
+
+	if (i == message->field_count) {
+		message->keys[i] = key_index;
+		message->field_count++;
+	}
+	snprintf(message->values[i], sizeof(message->values[i]), "%s", value);
+}
+
+/*
+ * @brief Sends the queued messages of a widget instance, in the order they were queued.
+ */
+static void _flush_instance(struct widget_instance *instance)
+{
+	int i;
+
+	instance->dirty = EINA_FALSE;
+
+	for (i = 0; i < instance->queued && !instance->gone; i++) {
+		_send_message(instance, &instance->queue[i]);
+	}
+
+	instance->queued = 0;
+}
+
+/*
+ * @brief Sends the values of a message that differ from the ones last sent about its alarm, in one update.
+ * A message whose values are all known to the widget is not sent. A message without values, e.g. Destroy,
+ * is always sent, and the widget forgets the values of the alarm with it.
+ */
+static void _send_message(struct widget_instance *instance, const struct widget_message *message)
+{
+	struct widget_sent *sent = _get_sent(instance, message->alarm_id);
+	uint64_t digests[WIDGET_MAX_FIELDS];
+	int changed[WIDGET_MAX_FIELDS];
+	int changed_count = 0;
+	char alarm_id_str[WIDGET_VALUE_LEN] = { 0, };
+	bundle *b = NULL;
+	int key = 0;
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < message->field_count; i++) {
+		key = message->keys[i];
+		digests[i] = _value_digest(message->values[i]);
+		if (sent && (sent->known >> key & 1) && sent->digests[key] == digests[i]) {
+			continue;
+		}
+		changed[changed_count++] = i;
+	}
+
+	if (message->field_count > 0 && changed_count == 0) {
+		s_info.suppressed_count++;
+		return;
+	}
+
+	b = bundle_create();
+	if (b == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to create a widget data bundle.");
+		return;
+	}
+
+	bundle_add_str(b, WIDGET_OPERATION_KEY, message->operation);
+	if (message->alarm_id != WIDGET_NO_ALARM) {
+		snprintf(alarm_id_str, sizeof(alarm_id_str), "%d", message->alarm_id);
+		bundle_add_str(b, WIDGET_ALARM_ID_KEY, alarm_id_str);
+	}
+	for (i = 0; i < changed_count; i++) {
+		bundle_add_str(b, s_widget_keys[message->keys[changed[i]]], message->values[changed[i]]);
+	}
+
+	ret = widget_service_trigger_update(instance->widget_id, instance->instance_id, b, 0);
+	bundle_free(b);
+
+	if (ret == WIDGET_ERROR_NOT_EXIST) {
+		instance->gone = EINA_TRUE;
+		return;
+	}
+
+	/*
+	 * Failed messages are not retried. The next message about the alarm is sent in full.
+	 */
+	if (ret != WIDGET_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to widget_service_trigger_update(). ret = %d", ret);
+		if (sent) {
+			sent->known = 0;
+		}
+		return;
+	}
+
+	s_info.sent_count++;
+
+	if (sent == NULL) {
+		/*
+		 * Every slot is taken by alarms that are not followed anymore, the oldest one goes.
+		 */
+		if (instance->sent_count == WIDGET_MAX_SUBSCRIPTIONS + 1) {
+			memmove(&instance->sent[0], &instance->sent[1], (instance->sent_count - 1) * sizeof(instance->sent[0]));
+			instance->sent_count--;
+		}
+		sent = &instance->sent[instance->sent_count++];
+		sent->alarm_id = message->alarm_id;
+		sent->known = 0;
+	}
+
+	if (message->field_count == 0) {
+		sent->known = 0;
+		return;
+	}
+
+	for (i = 0; i < changed_count; i++) {
+		key = message->keys[changed[i]];
+		sent->known |= 1u << key;
+		sent->digests[key] = digests[changed[i]];
+	}
+}
+
+/*
+ * @brief Finds the last message sent to a widget instance about an alarm.
+ * @return The message, or NULL if none was sent
+ */
+static struct widget_sent *_get_sent(struct widget_instance *instance, int alarm_id)
+{
+	int i;
+
+	for (i = 0; i < instance->sent_count; i++) {
+		if (instance->sent[i].alarm_id == alarm_id) {
+			return &instance->sent[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief Computes the 64-bit FNV-1a hash of a value.
+ */
+static uint64_t _value_digest(const char *value)
+{
+	uint64_t digest = 0xcbf29ce484222325ULL;
+	const char *p = NULL;
+
+	for (p = value; *p; p++) {
+		digest = (digest ^ (unsigned char) *p) * 0x100000001b3ULL;
+	}
+
+	return digest;
+}
+
+/*
+ * @brief Sends the queued values once the main loop is idle.
+ */
+static Eina_Bool _flush_idler_cb(void *data)
+{
+	s_info.flush_idler = NULL;
+	widget_queue_flush();
+
+	dlog_print(DLOG_DEBUG, LOG_TAG, "Widget updates sent(%d), suppressed(%d)", s_info.sent_count, s_info.suppressed_count);
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/*
+ * @brief Loads the registry from preferences.
+ * Every line holds the widget ID, the instance ID and the comma separated alarm IDs, separated by tabs.
+ */
+static void _load_registry(void)
+{
+	struct widget_instance *instance = NULL;
+	char *str = NULL;
+	char *line = NULL;
+	char *line_save = NULL;
+	char *widget_id = NULL;
+	char *instance_id = NULL;
+	char *alarm_ids = NULL;
+	char *alarm_id = NULL;
+	char *field_save = NULL;
+
+	if (preference_get_string(WIDGET_REGISTRY_KEY, &str) != PREFERENCE_ERROR_NONE || str == NULL) {
+		return;
+	}
+
+	for (line = strtok_r(str, "\n", &line_save); line; line = strtok_r(NULL, "\n", &line_save)) {
+		widget_id = strtok_r(line, "\t", &field_save);
+		instance_id = strtok_r(NULL, "\t", &field_save);
+		alarm_ids = strtok_r(NULL, "\t", &field_save);
+
+		if (widget_id == NULL || instance_id == NULL) {
+			continue;
+		}
+
+		instance = _add_instance(widget_id, instance_id);
+		if (instance == NULL || alarm_ids == NULL) {
+			continue;
+		}
+
+		for (alarm_id = strtok_r(alarm_ids, ",", &field_save);
+				alarm_id && instance->alarm_count < WIDGET_MAX_SUBSCRIPTIONS;
+				alarm_id = strtok_r(NULL, ",", &field_save)) {
+			instance->alarm_ids[instance->alarm_count++] = atoi(alarm_id);
+		}
+	}
+
+	free(str);
+
+	dlog_print(DLOG_INFO, LOG_TAG, "Loaded %d widget instances.", eina_hash_population(s_info.instances));
+}
+
+/*
+ * @brief Stores the registry in preferences.
+ */
+static void _save_registry(void)
+{
+	Eina_Strbuf *buf = NULL;
+
+	buf = eina_strbuf_new();
+	if (buf == NULL) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed to save the widget registry.");
+		return;
+	}
+
+	eina_hash_foreach(s_info.instances, _save_instance_cb, buf);
+
+	if (preference_set_string(WIDGET_REGISTRY_KEY, eina_strbuf_string_get(buf)) != PREFERENCE_ERROR_NONE) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "Failed at preference_set_string()");
+	}
+
+	eina_strbuf_free(buf);
+}
+
+/*
+ * @brief Appends a line of a widget instance to the saved registry.
+ */
+static Eina_Bool _save_instance_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata)
+{
+	struct widget_instance *instance = data;
+	Eina_Strbuf *buf = fdata;
+	int i;
+
+	eina_strbuf_append_printf(buf, "%s\t%s\t", instance->widget_id, instance->instance_id);
+	for (i = 0; i < instance->alarm_count; i++) {
+		eina_strbuf_append_printf(buf, i ? ",%d" : "%d", instance->alarm_ids[i]);
+	}
+	eina_strbuf_append_printf(buf, "%s", "\n");
+
+	return EINA_TRUE;
+}
+
+/*
+ * @brief Queues a message for a widget instance if it is subscribed to the alarm.
+ */
+static Eina_Bool _send_for_alarm_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata)
+{
+	struct widget_instance *instance = data;
+	struct widget_alarm_message *alarm_message = fdata;
+
+	if (_is_subscribed(instance, alarm_message->alarm_id)) {
+		_queue_message(instance, alarm_message->alarm_id, alarm_message->operation, alarm_message->values, alarm_message->count);
+	}
+
+	return EINA_TRUE;
+}
+
+/*
+ * @brief Queues the payload for a widget instance.
+ */
+static Eina_Bool _push_payload_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata)
+{
+	struct widget_instance *instance = data;
+	struct widget_payload *payload = fdata;
+	char next_time[WIDGET_VALUE_LEN] = { 0, };
+	char remaining_today[WIDGET_VALUE_LEN] = { 0, };
+	char streak[WIDGET_VALUE_LEN] = { 0, };
+	const struct widget_value values[] = {
+		{ "NextTime", next_time },
+		{ "NextText", payload->next_text },
+		{ "RemainingToday", remaining_today },
+		{ "Streak", streak },
+	};
+
+	snprintf(next_time, sizeof(next_time), "%lld", (long long) payload->next_epoch);
+	snprintf(remaining_today, sizeof(remaining_today), "%d", payload->remaining_today);
+	snprintf(streak, sizeof(streak), "%d", payload->streak);
+
+	_queue_message(instance, WIDGET_NO_ALARM, "SetNext", values, sizeof(values) / sizeof(values[0]));
+
+	return EINA_TRUE;
+}
+
+/*
+ * @brief Moves or removes the subscription of a widget instance to an alarm.
+ */
+static Eina_Bool _move_alarm_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata)
+{
+	struct widget_instance *instance = data;
+	struct widget_alarm_move *move = fdata;
+	int i;
+
+	for (i = 0; i < instance->alarm_count; i++) {
+		if (instance->alarm_ids[i] != move->old_alarm_id) {
+			continue;
+		}
+
+		if (move->new_alarm_id < 0) {
+			instance->alarm_ids[i] = instance->alarm_ids[--instance->alarm_count];
+		} else {
+			instance->alarm_ids[i] = move->new_alarm_id;
+		}
+		move->changed = EINA_TRUE;
+		break;
+	}
+
+	return EINA_TRUE;
+}
+
+/* End of file */